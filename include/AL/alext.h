@@ -2,6 +2,7 @@
 #define _LAL_EXT_H_
 
 #include "AL/altypes.h"
+#include "AL/alctypes.h"
 #include "alexttypes.h"
 
 #ifdef __cplusplus
@@ -22,6 +23,16 @@ ALAPI ALfloat alcGetAudioChannel_LOKI(ALuint channel);
 ALAPI void alcSetAudioChannel_LOKI(ALuint channel, ALfloat volume);
 ALAPI void alBombOnError_LOKI(void);
 ALAPI void alBufferi_LOKI(ALuint bid, ALenum param, ALint value);
+
+/* Callback(sid, bid, data, format, freq, samples) is called by the
+   mixer thread for each source playing the buffer, with the number of
+   16 bit samples of format and freq it is about to mix.  It returns
+   how many it wrote to data, fewer ends the stream for that source.
+   The call is made in the middle of the mixing cycle, with no ring in
+   between: its time counts against the period and a late return is an
+   underrun for every source.  It must not block or call into the
+   library.  To produce samples on a thread of your own, append them
+   to a streaming buffer instead. */
 ALAPI void alBufferDataWithCallback_LOKI(ALuint bid,
 					 int (*Callback)(ALuint, ALuint, ALshort *, ALenum, ALint, ALint));
 
@@ -31,6 +42,29 @@ ALAPI void alBufferWriteData_LOKI( ALuint   buffer,
                    ALsizei  size,
                    ALsizei  freq,
                    ALenum   internalFormat );
+/* Plays the 8 or 16 bit samples at data without copying them.  They must
+   stay valid and unchanged until alBufferData, alBufferDataStatic_EXT
+   or alDeleteBuffers on the buffer succeeds, which they don't while a
+   source still plays it. */
+ALAPI void alBufferDataStatic_EXT( ALuint   buffer,
+				   ALenum   format,
+				   ALvoid*  data,
+				   ALsizei  size,
+				   ALsizei  freq );
+
+/* Overwrites length bytes of the buffer's samples from offset on, in
+   place and also while sources play it.  Regions behind a source's
+   AL_SAMPLE_OFFSET or well ahead of it can be rewritten safely. */
+ALAPI void alBufferSubData_EXT( ALuint   buffer,
+				ALenum   format,
+				const ALvoid *data,
+				ALsizei  offset,
+				ALsizei  length );
+
+/* Streaming buffers hold a ring of at least a second, fixed in format
+   and size by the first append.  The append calls copy as much as
+   there is room for behind the source playing it and return how many
+   bytes of data that was.  One thread appends, one source plays. */
 ALAPI void ALAPIENTRY alGenStreamingBuffers_LOKI( ALsizei n, ALuint *samples );
 ALAPI ALsizei alBufferAppendData_LOKI( ALuint   buffer,
 				       ALenum   format,
@@ -45,6 +79,14 @@ ALAPI ALsizei alBufferAppendWriteData_LOKI( ALuint   buffer,
 					    ALsizei  freq,
 					    ALenum internalFormat );
 
+/* Loopback device, mixes into the caller's buffer instead of a pcm.
+   frames are interleaved signed 16 bit at the device's channels and
+   the context's ALC_FREQUENCY. */
+
+ALAPI ALCdevice *alcOpenLoopbackDevice_EXT( const ALubyte *tokstr );
+ALAPI void alcRenderContext_EXT( ALCcontext *context,
+				 ALshort *buffer, ALCsizei frames );
+
 /* Capture api */
 
 ALAPI ALboolean alCaptureInit_EXT( ALenum format, ALuint rate, ALsizei bufferSize );
@@ -68,6 +110,12 @@ ALAPI ALboolean ALAPIENTRY alutLoadMS_ADPCMData_LOKI(ALuint bid,
 						     void *data, int size,
 						     alMSADPCM_state_LOKI *mss);
 
+/* Sample banks, see almkbank.  Every sound in the bank becomes a buffer
+   playing straight from the mapped file.  The buffers belong to the
+   bank, alutCloseBank_EXT deletes them and fails while any is in use. */
+ALAPI alBank_EXT *alutOpenBank_EXT(const ALubyte *file);
+ALAPI ALuint alutGetBankBuffer_EXT(alBank_EXT *bank, const ALubyte *name);
+ALAPI ALboolean alutCloseBank_EXT(alBank_EXT *bank);
 
 #ifdef __cplusplus
 }
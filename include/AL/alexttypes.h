@@ -13,6 +13,39 @@
 #define AL_FORMAT_QUAD8_LOKI                      0x10004
 #define AL_FORMAT_QUAD16_LOKI                     0x10005
 
+/* signed 16 bit in big endian byte order, whatever the host's */
+#define AL_FORMAT_MONO16_BE_EXT                   0x10006
+#define AL_FORMAT_STEREO16_BE_EXT                 0x10007
+
+/* 32 bit float samples between -1.0 and 1.0 */
+#define AL_FORMAT_MONO_FLOAT32                    0x10010
+#define AL_FORMAT_STEREO_FLOAT32                  0x10011
+
+/**
+ * Multichannel formats.  Channels are interleaved in the order
+ * front left, front right, front center, LFE, rear left, rear right,
+ * side left, side right; quad has only the fronts and rears.  Each
+ * channel plays on its own speaker, folded into the nearest one the
+ * device has.
+ */
+#define AL_FORMAT_QUAD8                           0x1204
+#define AL_FORMAT_QUAD16                          0x1205
+#define AL_FORMAT_QUAD32                          0x1206
+#define AL_FORMAT_51CHN8                          0x120A
+#define AL_FORMAT_51CHN16                         0x120B
+#define AL_FORMAT_51CHN32                         0x120C
+#define AL_FORMAT_71CHN8                          0x1210
+#define AL_FORMAT_71CHN16                         0x1211
+#define AL_FORMAT_71CHN32                         0x1212
+
+/**
+ * Source query, read only.  The frame of the current buffer the
+ * mixer reads next, same value as in OpenAL 1.1.
+ *
+ * Type:   ALint.
+ */
+#define AL_SAMPLE_OFFSET                          0x1025
+
 /**
  * token extensions, base 0x20000
  */
@@ -29,6 +62,19 @@
  */
 #define AL_GAIN_LINEAR_LOKI                      0x20000
 
+/**
+ * Buffer attribute set with alBufferi_LOKI.  When AL_TRUE, data
+ * uploaded afterwards is converted to the current context's output
+ * rate on a background thread, so sources playing it at a pitch of
+ * 1.0 don't need to resample.  AL_FREQUENCY reports the new rate once
+ * it is done, attaching or queueing the buffer before then finishes
+ * the conversion first.
+ *
+ * Type:   ALboolean.
+ * Default: AL_FALSE.
+ */
+#define AL_BUFFER_DEVICE_RATE_EXT                0x20001
+
 
 /*
  * types for special loaders.  This should be deprecated in favor
@@ -87,6 +133,84 @@ typedef struct IMA_ADPCM_decoder {
  */
 #define ALC_BUFFERS_LOKI                         0x200001
 
+/**
+ * Mixer thread scheduling, also valid for alcGetIntegerv which
+ * reports what is actually in effect.
+ * base 0x400000
+ */
+
+/**
+ * followed by the SCHED_FIFO priority, 0 for normal scheduling
+ */
+#define ALC_REALTIME_PRIORITY_EXT                0x400000
+
+/**
+ * followed by the cpu to pin the mixer thread to, -1 for any
+ */
+#define ALC_CPU_AFFINITY_EXT                     0x400001
+
+/**
+ * followed by ALC_TRUE to lock the process memory with mlockall
+ */
+#define ALC_MEMORY_LOCK_EXT                      0x400002
+
+/**
+ * Output buffering, alcGetIntegerv reports what the pcm was given
+ */
+
+/**
+ * followed by the buffer size in frames
+ */
+#define ALC_BUFFER_SIZE_EXT                      0x400003
+
+/**
+ * followed by the number of periods in the buffer
+ */
+#define ALC_PERIODS_EXT                          0x400004
+
+/**
+ * followed by ALC_TRUE to start with a short queue that grows on
+ * underruns and shrinks back while playback is stable
+ */
+#define ALC_ADAPTIVE_LATENCY_EXT                 0x400005
+
+/**
+ * alcGetIntegerv only, the frames currently kept queued for output
+ */
+#define ALC_LATENCY_EXT                          0x400006
+
+/**
+ * Mixer counters, alcGetIntegerv only.  They are kept by the mixer
+ * and read without taking any lock, the totals wrap around.
+ */
+
+/**
+ * ALC_MIX_TIME_BUCKETS_EXT counts of mix cycles by duration, bucket n
+ * holds the cycles that took less than 2^n microseconds and at least
+ * half that, the last one every longer cycle
+ */
+#define ALC_MIX_TIME_HISTOGRAM_EXT               0x400007
+#define ALC_MIX_TIME_BUCKETS_EXT                 16
+
+/**
+ * underruns the mixer had to recover from
+ */
+#define ALC_XRUNS_EXT                            0x400008
+
+/**
+ * mix cycles run, and how many of them in the last second
+ */
+#define ALC_WAKEUPS_EXT                          0x400009
+#define ALC_WAKEUPS_PER_SECOND_EXT               0x40000a
+
+/**
+ * sources mixed and sources passed over because they were not
+ * playing, totals over every block mixed and for the last one
+ */
+#define ALC_VOICES_MIXED_EXT                     0x40000b
+#define ALC_VOICES_SKIPPED_EXT                   0x40000c
+#define ALC_ACTIVE_VOICES_EXT                    0x40000d
+
 /*
  *  Channel operations are probably a big no-no and destined
  *  for obsolesence.
@@ -114,6 +238,12 @@ typedef void (*PFNALBUFFERWRITEDATAPROC)( ALuint   buffer,
                    ALsizei  freq,
                    ALenum   internalFormat );
 
+typedef void (*PFNALBUFFERDATASTATICPROC)( ALuint   buffer,
+                   ALenum   format,
+                   ALvoid*  data,
+                   ALsizei  size,
+                   ALsizei  freq );
+
 typedef void (*PFNALGENSTREAMINGBUFFERSPROC)( ALsizei n, ALuint *samples );
 
 typedef ALsizei (*PFNALBUFFERAPPENDDATAPROC)( ALuint   buffer,
@@ -158,4 +288,12 @@ typedef ALboolean (*ALUTLOADMS_ADPCMDATAPROC)(ALuint bid,
 				void *data, int size,
 				alMSADPCM_state_LOKI *mss);
 
+/* sample banks */
+typedef struct _alBank_EXT alBank_EXT;
+
+typedef alBank_EXT *(*PFNALUTOPENBANKPROC)(const ALubyte *file);
+typedef ALuint (*PFNALUTGETBANKBUFFERPROC)(alBank_EXT *bank,
+				const ALubyte *name);
+typedef ALboolean (*PFNALUTCLOSEBANKPROC)(alBank_EXT *bank);
+
 #endif /* _LAL_EXTTYPES_H_ */
@@ -0,0 +1,198 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "al_adpcm.h"
+
+static const ALshort _al_ima_steps[89] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+	34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+	157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544,
+	598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707,
+	1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+	5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const ALbyte _al_ima_index[8] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static ALvoid _alIMANibble(AL_decoder *dec, ALuint c, ALuint nibble)
+{
+	ALint step = _al_ima_steps[dec->index[c]];
+	ALint diff = step >> 3;
+	ALint sample;
+	ALint index;
+
+	if (nibble & 1)
+	{
+		diff += step >> 2;
+	}
+
+	if (nibble & 2)
+	{
+		diff += step >> 1;
+	}
+
+	if (nibble & 4)
+	{
+		diff += step;
+	}
+
+	sample = dec->sample[c] + ((nibble & 8) ? -diff : diff);
+
+	if (sample > 32767)
+	{
+		sample = 32767;
+	}
+	else if (sample < -32768)
+	{
+		sample = -32768;
+	}
+
+	index = dec->index[c] + _al_ima_index[nibble & 7];
+
+	if (index < 0)
+	{
+		index = 0;
+	}
+	else if (index > 88)
+	{
+		index = 88;
+	}
+
+	dec->index[c] = index;
+
+	dec->sample[c] = sample;
+}
+
+/* Decode n frames on from dec->frame, into dst if it is given */
+static ALvoid _alIMADecode(AL_decoder *dec, AL_buffer *buf,
+			   ALfloat **dst, ALuint n)
+{
+	ALuint channels = buf->channels;
+	ALuint group = 4 * channels;
+	ALuint i = 0;
+	ALuint c;
+
+	while (i < n)
+	{
+		int64_t block = dec->frame / buf->block_frames;
+		ALuint f = dec->frame - block * buf->block_frames;
+		const ALubyte *data = (const ALubyte *)buf->data +
+				      block * buf->block;
+		ALuint m;
+
+		/* Every block starts from the sample in its header */
+		if (!f)
+		{
+			for (c = 0; c < channels; c++)
+			{
+				const ALubyte *head = data + 4 * c;
+
+				dec->sample[c] = (ALshort)(head[0] |
+							   (head[1] << 8));
+				dec->index[c] = head[2] > 88 ? 88 : head[2];
+			}
+		}
+
+		m = buf->block_frames - f;
+
+		if (m > n - i)
+		{
+			m = n - i;
+		}
+
+		for (; m; m--, f++, i++)
+		{
+			ALshort *history = dec->history[dec->frame & _AL_DECODE_MASK];
+
+			if (f)
+			{
+				/* Eight frames of four bit samples per group,
+				   four bytes for each channel in turn */
+				const ALubyte *p = data + group +
+						   ((f - 1) >> 3) * group +
+						   (((f - 1) & 7) >> 1);
+				ALuint shift = ((f - 1) & 1) << 2;
+
+				for (c = 0; c < channels; c++)
+				{
+					_alIMANibble(dec, c,
+						     (p[4 * c] >> shift) & 15);
+				}
+			}
+
+			for (c = 0; c < channels; c++)
+			{
+				history[c] = dec->sample[c];
+
+				if (dst)
+				{
+					dst[c][i] = dec->sample[c];
+				}
+			}
+
+			dec->frame++;
+		}
+	}
+}
+
+ALvoid _alDecodeIMA(AL_decoder *dec, AL_buffer *buf, ALfloat **dst,
+		    int64_t first, ALuint count)
+{
+	ALuint channels = buf->channels;
+	ALuint i, c;
+
+	if (dec->buffer != buf || dec->stamp != buf->stamp ||
+	    first > dec->frame || first < dec->start ||
+	    first < dec->frame - _AL_DECODE_HISTORY)
+	{
+		/* Seek, decoding from the start of the block */
+		dec->buffer = buf;
+		dec->stamp = buf->stamp;
+		dec->frame = first - first % buf->block_frames;
+		dec->start = dec->frame;
+
+		_alIMADecode(dec, buf, 0, first - dec->frame);
+	}
+
+	/* What the last call already decoded */
+	for (i = 0; i < count && first + i < dec->frame; i++)
+	{
+		for (c = 0; c < channels; c++)
+		{
+			dst[c][i] = dec->history[(first + i) & _AL_DECODE_MASK][c];
+		}
+	}
+
+	if (i < count)
+	{
+		ALfloat *rest[_AL_MAX_LOAD];
+
+		for (c = 0; c < channels; c++)
+		{
+			rest[c] = dst[c] + i;
+		}
+
+		_alIMADecode(dec, buf, rest, count - i);
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _AL_ADPCM_H_
+#define _AL_ADPCM_H_
+
+#include <stdint.h>
+
+#include <AL/al.h>
+
+#include "al_buffer.h"
+#include "al_mixer.h"
+
+/* WAVE_FORMAT_IMA_ADPCM */
+#define _AL_WAVE_IMA_ADPCM 0x0011
+
+/* Decoded frames kept behind the decoder, the interpolators read the
+   last few frames of one fetch again at the start of the next */
+#define _AL_DECODE_HISTORY 8
+#define _AL_DECODE_MASK (_AL_DECODE_HISTORY - 1)
+
+/* Where a voice has got to in an IMA ADPCM buffer.  Carrying on from
+   here costs one frame per frame, anywhere else at most one block.
+   Callback buffers use it the same way, only they can't seek. */
+typedef struct _AL_decoder
+{
+	AL_buffer *buffer;
+	ALuint stamp;
+	int64_t start;		/* first frame decoded since seeking */
+	int64_t frame;		/* next frame to decode */
+	int64_t end;		/* where a callback stream ran out */
+	ALint sample[_AL_MAX_LOAD];
+	ALint index[_AL_MAX_LOAD];
+	ALshort history[_AL_DECODE_HISTORY][_AL_MAX_LOAD];
+}
+AL_decoder;
+
+/* Frames in a block of the given size in bytes */
+#define _alIMABlockFrames(block, channels) \
+	((((block) - 4 * (channels)) / (4 * (channels))) * 8 + 1)
+
+/* Decode count frames from first on into float lines */
+ALvoid _alDecodeIMA(AL_decoder *, AL_buffer *, ALfloat **dst,
+		    int64_t first, ALuint count);
+
+#endif
@@ -19,325 +19,1230 @@
 
 #include <sys/types.h>
 #include <stdlib.h>
+#include <string.h>
 #include <alloca.h>
 #include <pthread.h>
 #include <stdio.h>
 
+#include <AL/alext.h>
+
 #include "al_buffer.h"
+#include "al_adpcm.h"
+#include "al_rate.h"
+#include "al_mixer.h"
 #include "al_error.h"
+#include "alc_context.h"
+
+/* Held to take slots off the free list and to grow the table */
+static pthread_mutex_t _al_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static AL_buffer *_al_buffer_chunks[_AL_BUFFER_CHUNKS];
+static ALuint _al_buffer_slots = 0;
+
+/* Deleted slots, pushed by whichever thread lets go of a buffer last
+   and only popped with the mutex held */
+static AL_buffer *_al_free_buffers = 0;
+
+static AL_buffer *_alFindBuffer(ALuint bid)
+{
+	AL_buffer *chunk;
+	AL_buffer *buf;
+	ALuint slot = (bid & _AL_BUFFER_SLOT_MASK) - 1;
+
+	if (slot >= _AL_BUFFER_CHUNKS * _AL_BUFFER_CHUNK)
+	{
+		return 0;
+	}
+
+	if (!(chunk = __atomic_load_n(&_al_buffer_chunks[slot >>
+							 _AL_BUFFER_CHUNK_BITS],
+				      __ATOMIC_ACQUIRE)))
+	{
+		return 0;
+	}
+
+	buf = &chunk[slot & (_AL_BUFFER_CHUNK - 1)];
+
+	if (__atomic_load_n(&buf->id, __ATOMIC_ACQUIRE) != bid)
+	{
+		return 0;
+	}
+
+	return buf;
+}
+
+/* The buffer may be deleted and its slot used again at any time
+   without the mutex, a value read from it only counts if the id is
+   still the same afterwards */
+static ALboolean _alSameBuffer(AL_buffer *buf, ALuint bid)
+{
+	return __atomic_load_n(&buf->id, __ATOMIC_ACQUIRE) == bid;
+}
+
+AL_buffer *_alLockBuffer(ALuint bid)
+{
+	AL_buffer *buf;
+	ALuint used;
+
+	if (!(buf = _alFindBuffer(bid)))
+	{
+		return 0;
+	}
+
+	used = __atomic_load_n(&buf->used, __ATOMIC_RELAXED);
+
+	do
+	{
+		if (used & _AL_BUFFER_DEAD)
+		{
+			return 0;
+		}
+	}
+	while (!__atomic_compare_exchange_n(&buf->used, &used, used + 1, 1,
+					    __ATOMIC_ACQUIRE,
+					    __ATOMIC_RELAXED));
+
+	/* Deleted and the slot given to another buffer in between */
+	if (!_alSameBuffer(buf, bid))
+	{
+		_alUnlockBuffer(buf);
+		return 0;
+	}
+
+	return buf;
+}
+
+ALvoid _alUnlockBuffer(AL_buffer *buf)
+{
+	__atomic_sub_fetch(&buf->used, 1, __ATOMIC_RELEASE);
+}
+
+static ALboolean _alClaimBuffer(AL_buffer *buf)
+{
+	ALuint used = 1;
+
+	return __atomic_compare_exchange_n(&buf->used, &used,
+					   1 | _AL_BUFFER_WRITING, 0,
+					   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static ALvoid _alUnclaimBuffer(AL_buffer *buf)
+{
+	__atomic_and_fetch(&buf->used, ~_AL_BUFFER_WRITING, __ATOMIC_RELEASE);
+}
+
+static ALboolean _alWriting(AL_buffer *buf)
+{
+	return (__atomic_load_n(&buf->used, __ATOMIC_ACQUIRE) &
+		_AL_BUFFER_WRITING) != 0;
+}
+
+AL_buffer *_alUseBuffer(ALuint bid)
+{
+	AL_buffer *buf;
+
+	if ((buf = _alLockBuffer(bid)))
+	{
+		_alRateFinish(buf);
+	}
+
+	return buf;
+}
+
+/* Samples replaced while the mixer held the buffer */
+typedef struct _AL_retired
+{
+	struct _AL_retired *next;
+	ALvoid *data;
+	AL_stream *stream;
+}
+AL_retired;
+
+static ALvoid _alFreeRetired(AL_buffer *buf)
+{
+	AL_retired *old, *next;
+
+	old = __atomic_exchange_n(&buf->retired, 0, __ATOMIC_ACQ_REL);
+
+	for (; old; old = next)
+	{
+		next = old->next;
+		free(old->data);
+		free(old->stream);
+		free(old);
+	}
+}
+
+static ALboolean _alMixing(AL_buffer *buf)
+{
+	return (__atomic_load_n(&buf->mixing, __ATOMIC_SEQ_CST) &
+		~_AL_BUFFER_DEAD) != 0;
+}
+
+ALvoid _alBeginWrite(AL_buffer *buf)
+{
+	__atomic_store_n(&buf->stamp, buf->stamp + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+ALvoid _alEndWrite(AL_buffer *buf)
+{
+	__atomic_store_n(&buf->stamp, buf->stamp + 1, __ATOMIC_RELEASE);
+}
+
+/* Free them now, or leave them to whichever side sees mixing drop to
+   zero */
+ALboolean _alDropData(AL_buffer *buf, ALvoid *data, AL_stream *stream)
+{
+	AL_retired *old, *head;
+
+	if (!_alMixing(buf))
+	{
+		free(data);
+		free(stream);
+		return AL_TRUE;
+	}
+
+	if (!(old = malloc(sizeof(AL_retired))))
+	{
+		return AL_FALSE;
+	}
+
+	old->data = data;
+	old->stream = stream;
+
+	head = __atomic_load_n(&buf->retired, __ATOMIC_RELAXED);
+
+	do
+	{
+		old->next = head;
+	}
+	while (!__atomic_compare_exchange_n(&buf->retired, &head, old, 1,
+					    __ATOMIC_ACQ_REL,
+					    __ATOMIC_RELAXED));
+
+	/* The mixer let go in between and found nothing to free */
+	if (!_alMixing(buf))
+	{
+		_alFreeRetired(buf);
+	}
+
+	return AL_TRUE;
+}
+
+ALboolean _alSnapBuffer(AL_buffer *buf, AL_buffer *copy)
+{
+	ALuint stamp = __atomic_load_n(&buf->stamp, __ATOMIC_ACQUIRE);
+
+	if (stamp & 1)
+	{
+		return AL_FALSE;
+	}
+
+	*copy = *buf;
+	copy->stamp = stamp;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&buf->stamp, __ATOMIC_RELAXED) == stamp;
+}
+
+/* Drop the samples, unless they belong to the application, between
+   _alBeginWrite and _alEndWrite.  The application may free static
+   samples once this returns, so the mixer must have let go of them. */
+static ALboolean _alFreeData(AL_buffer *buf)
+{
+	if (buf->borrowed && _alMixing(buf))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		return AL_FALSE;
+	}
+
+	_alRateCancel(buf);
+
+	/* Other data makes a ring an ordinary buffer */
+	if (!_alDropData(buf, buf->borrowed ? 0 : buf->data, buf->stream))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return AL_FALSE;
+	}
+
+	buf->data = 0;
+	buf->stream = 0;
+	buf->size = 0;
+	buf->borrowed = AL_FALSE;
+	buf->encoding = _AL_ENCODING_PCM16;
+
+	return AL_TRUE;
+}
+
+static ALvoid _alFreeBuffer(AL_buffer *buf)
+{
+	AL_buffer *head;
+
+	_alBeginWrite(buf);
+	_alFreeData(buf);
+	_alEndWrite(buf);
+	_alFreeRetired(buf);
+
+	head = __atomic_load_n(&_al_free_buffers, __ATOMIC_RELAXED);
+
+	do
+	{
+		buf->next = head;
+	}
+	while (!__atomic_compare_exchange_n(&_al_free_buffers, &head, buf, 1,
+					    __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED));
+}
+
+ALvoid _alRetainBuffer(AL_buffer *buf)
+{
+	__atomic_add_fetch(&buf->mixing, 1, __ATOMIC_RELAXED);
+}
+
+ALvoid _alReleaseBuffer(AL_buffer *buf)
+{
+	ALuint mixing = __atomic_sub_fetch(&buf->mixing, 1, __ATOMIC_SEQ_CST);
+
+	if (mixing == _AL_BUFFER_DEAD)
+	{
+		_alFreeBuffer(buf);
+	}
+	else if (!mixing)
+	{
+		_alFreeRetired(buf);
+	}
+}
+
+/* A slot off the free list, or the next one never used */
+static AL_buffer *_alNewBuffer(ALvoid)
+{
+	AL_buffer *buf, *chunk;
+	ALuint slot;
+
+	/* Only ever popped here, under the mutex, so the head can't be
+	   popped and pushed back behind our back */
+	buf = __atomic_load_n(&_al_free_buffers, __ATOMIC_ACQUIRE);
+
+	while (buf && !__atomic_compare_exchange_n(&_al_free_buffers, &buf,
+						   buf->next, 1,
+						   __ATOMIC_ACQUIRE,
+						   __ATOMIC_ACQUIRE));
+
+	if (buf)
+	{
+		return buf;
+	}
+
+	if ((slot = _al_buffer_slots) >= _AL_BUFFER_CHUNKS * _AL_BUFFER_CHUNK)
+	{
+		return 0;
+	}
+
+	if (!(chunk = _al_buffer_chunks[slot >> _AL_BUFFER_CHUNK_BITS]))
+	{
+		if (!(chunk = calloc(_AL_BUFFER_CHUNK, sizeof(AL_buffer))))
+		{
+			return 0;
+		}
+
+		__atomic_store_n(&_al_buffer_chunks[slot >> _AL_BUFFER_CHUNK_BITS],
+				 chunk, __ATOMIC_RELEASE);
+	}
+
+	_al_buffer_slots++;
+
+	buf = &chunk[slot & (_AL_BUFFER_CHUNK - 1)];
+	buf->slot = slot;
+	buf->generation = 0;
+
+	return buf;
+}
+
+static AL_buffer *_alGenBuffer(ALvoid)
+{
+	AL_buffer *buf;
+
+	if (!(buf = _alNewBuffer()))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return 0;
+	}
+
+	buf->next = 0;
+	buf->mixing = 0;
+	__atomic_store_n(&buf->used, 0, __ATOMIC_RELAXED);
+	buf->data = 0;
+	buf->borrowed = AL_FALSE;
+	buf->size = 0;
+	buf->freq = 0;
+	buf->channels = 1;
+	buf->encoding = _AL_ENCODING_PCM16;
+	buf->device_rate = AL_FALSE;
+	buf->rate = 0;
+	buf->rate_busy = AL_FALSE;
+	buf->stream = 0;
+
+	/* Visible to lookups from here on */
+	__atomic_store_n(&buf->id, (buf->generation << _AL_BUFFER_SLOT_BITS) |
+			 (buf->slot + 1), __ATOMIC_RELEASE);
+
+	return buf;
+}
+
+static ALvoid _alDeleteBuffer(AL_buffer *buf)
+{
+	__atomic_store_n(&buf->id, 0, __ATOMIC_RELEASE);
+
+	buf->generation = (buf->generation + 1) &
+			  (0xFFFFFFFF >> _AL_BUFFER_SLOT_BITS);
+
+	if (!__atomic_fetch_or(&buf->mixing, _AL_BUFFER_DEAD, __ATOMIC_ACQ_REL))
+	{
+		_alFreeBuffer(buf);
+	}
+}
+
+static ALboolean _alGenStream(AL_buffer *buf)
+{
+	if (posix_memalign((void **)&buf->stream, 64, sizeof(AL_stream)))
+	{
+		buf->stream = 0;
+		_alSetError(AL_OUT_OF_MEMORY);
+		return AL_FALSE;
+	}
+
+	buf->stream->claimed = 0;
+	buf->stream->write = 0;
+	buf->stream->read = 0;
+
+	return AL_TRUE;
+}
+
+ALboolean _alClaimStream(AL_buffer *buf)
+{
+	ALuint claimed = 0;
+
+	return __atomic_compare_exchange_n(&buf->stream->claimed, &claimed, 1,
+					   0, __ATOMIC_ACQUIRE,
+					   __ATOMIC_RELAXED);
+}
+
+ALvoid _alUnclaimStream(AL_buffer *buf)
+{
+	__atomic_store_n(&buf->stream->claimed, 0, __ATOMIC_RELEASE);
+}
+
+static ALvoid _alGenBuffers(ALsizei n, ALuint *buffers, ALboolean streaming)
+{
+	ALsizei i;
+	AL_buffer **temp;
+
+	if (n == 0)
+		return;
+
+	if (n < 0)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		return;
+	}
+
+	temp = alloca(n * sizeof(AL_buffer *));
+
+	pthread_mutex_lock(&_al_buffer_mutex);
+
+	for (i = 0; i < n; i++)
+	{
+		if (!(temp[i] = _alGenBuffer()) ||
+		    (streaming && !_alGenStream(temp[i])))
+		{
+			ALsizei j;
+
+			for (j = 0; j <= i && temp[j]; j++)
+			{
+				_alDeleteBuffer(temp[j]);
+			}
 
-#define HASH_SIZE 0x100
-#define HASH_MASK 0x0FF
+			goto unlock;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		buffers[i] = temp[i]->id;
+	}
+
+unlock:
+	pthread_mutex_unlock(&_al_buffer_mutex);
+}
+
+ALvoid alGenBuffers(ALsizei n, ALuint *buffers)
+{
+	_alGenBuffers(n, buffers, AL_FALSE);
+}
+
+/* Buffers filled with alBufferAppendData_LOKI while they play */
+ALvoid alGenStreamingBuffers_LOKI(ALsizei n, ALuint *buffers)
+{
+	_alGenBuffers(n, buffers, AL_TRUE);
+}
+
+ALvoid alDeleteBuffers(ALsizei n, ALuint *buffers)
+{
+	ALsizei i;
+	AL_buffer **temp;
+
+	if (n == 0)
+	{
+		return;
+	}
+
+	if (n < 0)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		return;
+	}
+
+	temp = alloca(n * sizeof(AL_buffer *));
+
+	/* Claim every buffer that isn't in use before deleting any */
+	for (i = 0; i < n; i++)
+	{
+		ALuint used = 0;
+
+		if (!(temp[i] = _alFindBuffer(buffers[i])))
+		{
+			_alSetError(AL_INVALID_NAME);
+			goto undo;
+		}
+
+		if (!__atomic_compare_exchange_n(&temp[i]->used, &used,
+						 _AL_BUFFER_DEAD, 0,
+						 __ATOMIC_ACQUIRE,
+						 __ATOMIC_RELAXED))
+		{
+			/* The same id may be in the list twice */
+			if (used & _AL_BUFFER_DEAD)
+			{
+				temp[i] = 0;
+				continue;
+			}
+
+			_alSetError(AL_INVALID_OPERATION);
+			goto undo;
+		}
+
+		/* The application may free static samples once this
+		   returns, so the mixer must have let go of them */
+		if (temp[i]->borrowed &&
+		    __atomic_load_n(&temp[i]->mixing, __ATOMIC_ACQUIRE))
+		{
+			__atomic_store_n(&temp[i]->used, 0, __ATOMIC_RELEASE);
+			_alSetError(AL_INVALID_OPERATION);
+			goto undo;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		if (temp[i])
+		{
+			_alDeleteBuffer(temp[i]);
+		}
+	}
+
+	return;
+
+undo:
+	while (i--)
+	{
+		if (temp[i])
+		{
+			__atomic_store_n(&temp[i]->used, 0, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+ALboolean alIsBuffer(ALuint bid)
+{
+	return _alFindBuffer(bid) ? AL_TRUE : AL_FALSE;
+}
+
+/* How the samples of an upload format are laid out */
+typedef struct _AL_format
+{
+	ALuint channels;
+	ALuint bytes;		/* per sample, 4 is float */
+	ALboolean swap;		/* not in the host's byte order */
+}
+AL_format;
+
+#define _AL_BIG_ENDIAN (__BYTE_ORDER == __BIG_ENDIAN)
+
+static const struct
+{
+	ALenum format;
+	ALuint channels;
+	ALuint bytes;
+	ALboolean big_endian;
+}
+_al_formats[] =
+{
+	{ AL_FORMAT_MONO8, 1, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_MONO16, 1, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_MONO_FLOAT32, 1, 4, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_STEREO8, 2, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_STEREO16, 2, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_STEREO_FLOAT32, 2, 4, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_QUAD8_LOKI, 4, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_QUAD16_LOKI, 4, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_QUAD8, 4, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_QUAD16, 4, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_QUAD32, 4, 4, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_51CHN8, 6, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_51CHN16, 6, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_51CHN32, 6, 4, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_71CHN8, 8, 1, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_71CHN16, 8, 2, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_71CHN32, 8, 4, _AL_BIG_ENDIAN },
+	{ AL_FORMAT_MONO16_BE_EXT, 1, 2, AL_TRUE },
+	{ AL_FORMAT_STEREO16_BE_EXT, 2, 2, AL_TRUE }
+};
+
+static ALboolean _alGetFormat(ALenum format, AL_format *fmt)
+{
+	ALuint i;
+
+	for (i = 0; i < sizeof(_al_formats) / sizeof(_al_formats[0]); i++)
+	{
+		if (_al_formats[i].format == format)
+		{
+			fmt->channels = _al_formats[i].channels;
+			fmt->bytes = _al_formats[i].bytes;
+			fmt->swap = _al_formats[i].big_endian != _AL_BIG_ENDIAN;
+
+			return AL_TRUE;
+		}
+	}
+
+	return AL_FALSE;
+}
+
+/* Bits per sample as stored */
+static ALuint _alBufferBits(AL_buffer *buf)
+{
+	switch (buf->encoding)
+	{
+	case _AL_ENCODING_PCM8:
+		return 8;
+	case _AL_ENCODING_IMA4:
+		return 4;
+	case _AL_ENCODING_FLOAT32:
+		return 32;
+	default:
+		return 16;
+	}
+}
+
+static const ALuint _al_encodings[5] =
+{
+	0, _AL_ENCODING_PCM8, _AL_ENCODING_PCM16, 0, _AL_ENCODING_FLOAT32
+};
+
+/* Convert samples from one format to another with the same channels.
+   Floats are only copied. */
+static ALvoid _alConvertSamples(ALvoid *dst, AL_format *from, AL_format *to,
+				const ALvoid *data, ALsizei samples)
+{
+	_alMixerInit();
+
+	if (from->bytes == to->bytes)
+	{
+		if (from->swap)
+		{
+			_alConvertSwap16(dst, data, samples);
+		}
+		else
+		{
+			memcpy(dst, data, samples * to->bytes);
+		}
+	}
+	else if (to->bytes == 2)
+	{
+		_alConvertWiden8(dst, data, samples);
+	}
+	else if (from->swap)
+	{
+		ALshort temp[1024];
+		ALsizei i, n;
+
+		for (i = 0; i < samples; i += n)
+		{
+			n = samples - i < 1024 ? samples - i : 1024;
+
+			_alConvertSwap16(temp, (const ALshort *)data + i, n);
+			_alConvertNarrow16((ALubyte *)dst + i, temp, n);
+		}
+	}
+	else
+	{
+		_alConvertNarrow16(dst, data, samples);
+	}
+}
+
+/* Copy the samples into the buffer as to */
+static ALvoid _alBufferStore(AL_buffer *buf, AL_format *from, AL_format *to,
+			     ALvoid *data, ALsizei size, ALsizei freq)
+{
+	ALsizei frames, samples;
+	ALvoid *copy;
+
+	/* ALsizei is unsigned unless LINUX_AL */
+	if ((ALint)size < 0 || (ALint)freq <= 0)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		return;
+	}
+
+	frames = size / (from->channels * from->bytes);
+	samples = frames * from->channels;
+
+	if (!(copy = malloc((size_t)samples * to->bytes)))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return;
+	}
+
+	_alConvertSamples(copy, from, to, data, samples);
+
+	_alBeginWrite(buf);
+
+	if (!_alFreeData(buf))
+	{
+		_alEndWrite(buf);
+		free(copy);
+		return;
+	}
+
+	buf->data = copy;
+	buf->encoding = _al_encodings[to->bytes];
+	buf->size = frames;
+	buf->freq = freq;
+	buf->channels = from->channels;
+
+	_alEndWrite(buf);
+
+	if (buf->device_rate && _alcCurrentContext)
+	{
+		_alRateSchedule(buf, _alcCurrentContext->device->freq);
+	}
+}
+
+ALvoid alBufferData(ALuint bid, ALenum format, ALvoid *data,
+		    ALsizei size, ALsizei freq)
+{
+	AL_buffer *buf;
+	AL_format from, to;
+
+	if (!(buf = _alLockBuffer(bid)))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	if (!_alClaimBuffer(buf))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
+	}
+
+	if (!_alGetFormat(format, &from))
+	{
+		_alSetError(AL_INVALID_ENUM);
+		goto unclaim;
+	}
+
+	/* Kept as given, only in the host's byte order */
+	to = from;
+	to.swap = AL_FALSE;
+
+	_alBufferStore(buf, &from, &to, data, size, freq);
+
+unclaim:
+	_alUnclaimBuffer(buf);
+unlock:
+	_alUnlockBuffer(buf);
+}
+
+/* Stored as internalFormat, which must have the same channels and be
+   float only if format is */
+ALvoid alBufferWriteData_LOKI(ALuint bid, ALenum format, ALvoid *data,
+			      ALsizei size, ALsizei freq,
+			      ALenum internalFormat)
+{
+	AL_buffer *buf;
+	AL_format from, to;
+
+	if (!(buf = _alLockBuffer(bid)))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	if (!_alClaimBuffer(buf))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
+	}
+
+	if (!_alGetFormat(format, &from) ||
+	    !_alGetFormat(internalFormat, &to) || to.swap)
+	{
+		_alSetError(AL_INVALID_ENUM);
+		goto unclaim;
+	}
+
+	if (from.channels != to.channels ||
+	    (from.bytes == 4) != (to.bytes == 4))
+	{
+		_alSetError(AL_INVALID_VALUE);
+		goto unclaim;
+	}
+
+	_alBufferStore(buf, &from, &to, data, size, freq);
+
+unclaim:
+	_alUnclaimBuffer(buf);
+unlock:
+	_alUnlockBuffer(buf);
+}
+
+/* The buffer plays the application's samples where they are.  They
+   must stay valid and unchanged until alBufferData, this again or
+   alDeleteBuffers on the buffer succeeds.  Those fail while any
+   source still plays the buffer. */
+ALvoid alBufferDataStatic_EXT(ALuint bid, ALenum format, ALvoid *data,
+			      ALsizei size, ALsizei freq)
+{
+	AL_buffer *buf;
+	AL_format fmt;
+
+	if (!(buf = _alLockBuffer(bid)))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	if (!_alClaimBuffer(buf))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
+	}
+
+	/* Only what the mixer reads as it is */
+	if (!_alGetFormat(format, &fmt) || fmt.swap)
+	{
+		_alSetError(AL_INVALID_ENUM);
+		goto unclaim;
+	}
+
+	/* Whole frames only, the mixer reads up to size as it is */
+	if (!data || ((size_t)data & (fmt.bytes - 1)) ||
+	    (ALint)size < 0 || (ALint)freq <= 0 ||
+	    size % (fmt.channels * fmt.bytes))
+	{
+		_alSetError(AL_INVALID_VALUE);
+		goto unclaim;
+	}
+
+	_alBeginWrite(buf);
+
+	if (_alFreeData(buf))
+	{
+		buf->data = data;
+		buf->borrowed = AL_TRUE;
+		buf->encoding = _al_encodings[fmt.bytes];
+		buf->size = size / (fmt.channels * fmt.bytes);
+		buf->freq = freq;
+		buf->channels = fmt.channels;
+	}
+
+	_alEndWrite(buf);
+
+unclaim:
+	_alUnclaimBuffer(buf);
+unlock:
+	_alUnlockBuffer(buf);
+}
+
+/* The buffer's samples come from Callback, called by the mixer for
+   every source playing it with exactly the samples it is about to
+   mix.  They are 16 bit with the channels and at the frequency of the
+   data the buffer held before, or stereo at the current context's rate
+   if it held none.  Returning fewer samples than asked for ends the
+   stream for that source. */
+ALvoid alBufferDataWithCallback_LOKI(ALuint bid,
+				     int (*Callback)(ALuint, ALuint, ALshort *,
+						     ALenum, ALint, ALint))
+{
+	AL_buffer *buf;
+
+	if (!(buf = _alLockBuffer(bid)))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	if (!_alClaimBuffer(buf))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
+	}
 
-static pthread_mutex_t _al_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+	if (!Callback)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		goto unclaim;
+	}
 
-static ALuint _al_last_buffer_id = 0;
-static AL_buffer *_al_buffers[HASH_SIZE];
+	if (!buf->freq && !_alcCurrentContext)
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unclaim;
+	}
 
-static AL_buffer *_alFindBuffer(ALuint bid)
-{
-	AL_buffer *buf;
+	_alBeginWrite(buf);
 
-	for (buf = _al_buffers[bid & HASH_MASK]; buf; buf = buf->next)
+	if (_alFreeData(buf))
 	{
-		if (buf->id == bid)
+		if (!buf->freq)
 		{
-			return buf;
+			buf->channels = 2;
+			buf->freq = _alcCurrentContext->device->freq;
 		}
+
+		/* As long as the mixer's cursor can count */
+		buf->encoding = _AL_ENCODING_CALLBACK;
+		buf->size = 0xFFFFFFFF;
+		buf->callback = Callback;
 	}
 
-	return 0;
+	_alEndWrite(buf);
+
+unclaim:
+	_alUnclaimBuffer(buf);
+unlock:
+	_alUnlockBuffer(buf);
 }
 
-AL_buffer *_alLockBuffer(ALuint bid)
+/* Overwrite part of the samples where they are, also while sources
+   play them.  offset and length are in bytes of data as format, which
+   converts to the stored format like alBufferWriteData_LOKI.  Each
+   sample is written whole, a mixer reading the region at the same
+   time mixes some old and some new ones. */
+ALvoid alBufferSubData_EXT(ALuint bid, ALenum format, const ALvoid *data,
+			   ALsizei offset, ALsizei length)
 {
 	AL_buffer *buf;
+	AL_format from, to;
+	ALsizei frame;
 
-	pthread_mutex_lock(&_al_buffer_mutex);
+	if (!(buf = _alLockBuffer(bid)))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
 
-	if ((buf = _alFindBuffer(bid)))
+	/* Being given other samples, compressed, the application's own,
+	   at another rate than the data it was given or a ring */
+	if (_alWriting(buf) ||
+	    buf->encoding == _AL_ENCODING_IMA4 || buf->borrowed ||
+	    buf->device_rate || buf->stream || !buf->data)
 	{
-		buf->used++;
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
 	}
 
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	if (!_alGetFormat(format, &from))
+	{
+		_alSetError(AL_INVALID_ENUM);
+		goto unlock;
+	}
 
-	return buf;
-}
+	to.channels = buf->channels;
+	to.bytes = _alBufferBits(buf) >> 3;
+	to.swap = AL_FALSE;
+	frame = from.channels * from.bytes;
 
-ALvoid _alUnlockBuffer(AL_buffer *buf)
-{
-	pthread_mutex_lock(&_al_buffer_mutex);
+	if (from.channels != to.channels ||
+	    (from.bytes == 4) != (to.bytes == 4) || !data ||
+	    offset < 0 || length < 0 || offset % frame || length % frame ||
+	    (ALuint)(offset / frame) > buf->size ||
+	    (ALuint)(length / frame) > buf->size - offset / frame)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		goto unlock;
+	}
 
-	buf->used--;
+	_alConvertSamples((ALubyte *)buf->data +
+			  offset / from.bytes * to.bytes,
+			  &from, &to, data, length / from.bytes);
 
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	/* Ahead of the mixer's next cycle */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+unlock:
+	_alUnlockBuffer(buf);
 }
 
-static AL_buffer *_alGenBuffer(ALvoid)
+/* A power of two frames holding at least a second and two appends of
+   the size of the first */
+static ALboolean _alStreamSetup(AL_buffer *buf, AL_format *fmt,
+				ALsizei frames, ALsizei freq)
 {
-	AL_buffer *buf;
-	ALuint bid;
+	ALuint size = 1;
+	ALvoid *data;
 
-	if (!(buf = malloc(sizeof(AL_buffer))))
+	while (size < (ALuint)freq || size < 2 * (ALuint)frames)
 	{
-		_alSetError(AL_OUT_OF_MEMORY);
-		return 0;
+		if (size >= 0x10000000 / (fmt->channels * fmt->bytes))
+		{
+			_alSetError(AL_INVALID_VALUE);
+			return AL_FALSE;
+		}
+
+		size <<= 1;
 	}
 
-	buf->used = 0;
-	buf->data = 0;
-	buf->size = 0;
-	buf->freq = 0;
-	buf->mono = AL_TRUE;
+	if (!(data = malloc(size * fmt->channels * fmt->bytes)))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return AL_FALSE;
+	}
 
-	bid = _al_last_buffer_id;
-	while (!++bid || _alFindBuffer(bid));
-	_al_last_buffer_id = bid;
+	/* Published to the mixer by the stamp */
+	_alBeginWrite(buf);
 
-	buf->id = bid;
+	buf->data = data;
+	buf->encoding = _al_encodings[fmt->bytes];
+	buf->size = size;
+	buf->freq = freq;
+	buf->channels = fmt->channels;
 
-	buf->next = _al_buffers[bid & HASH_MASK];
-	_al_buffers[bid & HASH_MASK] = buf;
+	_alEndWrite(buf);
 
-	return buf;
+	return AL_TRUE;
 }
 
-static ALvoid _alDeleteBuffer(AL_buffer *buf)
+/* Copy as many whole frames as the ring has room for behind the
+   mixer and return how many bytes of data that took.  Only one thread
+   may append to a buffer.  It holds the buffer for the call so it
+   can't be deleted or given other data meanwhile: the first append
+   sets the format and only then makes any frames visible to the
+   mixer. */
+static ALsizei _alBufferAppend(ALuint bid, ALenum format, ALvoid *data,
+			       ALsizei size, ALsizei freq,
+			       const ALenum *internalFormat)
 {
-	AL_buffer *b, **p;
+	AL_buffer *buf;
+	AL_stream *stream;
+	AL_format from, to;
+	uint64_t write, tail;
+	ALuint frames, room, mask, done, n;
+	ALsizei result = 0;
 
-	for (p = &_al_buffers[buf->id & HASH_MASK]; (b = *p); p = &b->next)
+	if (!(buf = _alLockBuffer(bid)))
 	{
-		if (b->id == buf->id)
-		{
-			*p = b->next;
-			break;
-		}
+		_alSetError(AL_INVALID_NAME);
+		return 0;
 	}
 
-	if (buf->data) free(buf->data);
-	free(buf);
-}
+	if (_alWriting(buf) || !(stream = buf->stream))
+	{
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
+	}
 
-ALvoid alGenBuffers(ALsizei n, ALuint *buffers)
-{
-	ALsizei i;
-	AL_buffer **temp;
+	if (!_alGetFormat(format, &from))
+	{
+		_alSetError(AL_INVALID_ENUM);
+		goto unlock;
+	}
 
-	if (n == 0)
-		return;
+	/* Without an internal format kept as given, in host byte order */
+	to = from;
+	to.swap = AL_FALSE;
 
-	if (n < 0)
+	if (internalFormat &&
+	    (!_alGetFormat(*internalFormat, &to) || to.swap))
 	{
-		_alSetError(AL_INVALID_VALUE);
-		return;
+		_alSetError(AL_INVALID_ENUM);
+		goto unlock;
 	}
 
-	temp = alloca(n * sizeof(AL_buffer *));
+	if (from.channels != to.channels ||
+	    (from.bytes == 4) != (to.bytes == 4) ||
+	    !data || (ALint)size < 0 || (ALint)freq <= 0)
+	{
+		_alSetError(AL_INVALID_VALUE);
+		goto unlock;
+	}
 
-	pthread_mutex_lock(&_al_buffer_mutex);
+	frames = size / (from.channels * from.bytes);
 
-	for (i = 0; i < n; i++)
+	if (!buf->data)
 	{
-		if (!(temp[i] = _alGenBuffer()))
+		if (!_alStreamSetup(buf, &to, frames, freq))
 		{
-			ALsizei j;
-
-			for (j = 0; j < i; j++)
-			{
-				_alDeleteBuffer(temp[j]);
-			}
-
 			goto unlock;
 		}
 	}
-
-	for (i = 0; i < n; i++)
+	else if (buf->channels != to.channels ||
+		 _alBufferBits(buf) != to.bytes << 3 || buf->freq != (ALuint)freq)
 	{
-		buffers[i] = temp[i]->id;
+		_alSetError(AL_INVALID_VALUE);
+		goto unlock;
 	}
 
-unlock:
-	pthread_mutex_unlock(&_al_buffer_mutex);
-}
-
-ALvoid alDeleteBuffers(ALsizei n, ALuint *buffers)
-{
-	ALsizei i;
-	AL_buffer **temp;
+	/* The interpolators read a few frames behind the mixer again */
+	write = stream->write;
+	tail = __atomic_load_n(&stream->read, __ATOMIC_ACQUIRE);
+	tail = tail > _AL_RESAMPLE_PRE ? tail - _AL_RESAMPLE_PRE : 0;
+	room = buf->size - (ALuint)(write - tail);
 
-	if (n == 0)
+	if (frames > room)
 	{
-		return;
+		frames = room;
 	}
 
-	if (n < 0)
-	{
-		_alSetError(AL_INVALID_VALUE);
-		return;
-	}
+	mask = buf->size - 1;
 
-	temp = alloca(n * sizeof(AL_buffer *));
+	for (done = 0; done < frames; done += n)
+	{
+		ALuint at = (ALuint)(write + done) & mask;
 
-	pthread_mutex_lock(&_al_buffer_mutex);
+		n = frames - done;
 
-	for (i = 0; i < n; i++)
-	{
-		if (!(temp[i] = _alFindBuffer(buffers[i])))
+		if (n > buf->size - at)
 		{
-			_alSetError(AL_INVALID_NAME);
-			goto unlock;
+			n = buf->size - at;
 		}
 
-		if (temp[i]->used)
-		{
-			_alSetError(AL_INVALID_OPERATION);
-			goto unlock;
-		}
+		_alConvertSamples((ALubyte *)buf->data +
+				  at * to.channels * to.bytes, &from, &to,
+				  (ALubyte *)data +
+				  done * from.channels * from.bytes,
+				  n * from.channels);
 	}
 
-	for (i = 0; i < n; i++)
-	{
-		_alDeleteBuffer(temp[i]);
-	}
+	__atomic_store_n(&stream->write, write + frames, __ATOMIC_RELEASE);
+
+	result = frames * from.channels * from.bytes;
 
 unlock:
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	_alUnlockBuffer(buf);
+
+	return result;
 }
 
-ALboolean alIsBuffer(ALuint bid)
+ALsizei alBufferAppendData_LOKI(ALuint bid, ALenum format, ALvoid *data,
+				ALsizei size, ALsizei freq)
 {
-	ALboolean value;
-
-	pthread_mutex_lock(&_al_buffer_mutex);
-
-	value = _alFindBuffer(bid) ? AL_TRUE : AL_FALSE;
-
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	return _alBufferAppend(bid, format, data, size, freq, 0);
+}
 
-	return value;
+ALsizei alBufferAppendWriteData_LOKI(ALuint bid, ALenum format,
+				     ALvoid *data, ALsizei size,
+				     ALsizei freq, ALenum internalFormat)
+{
+	return _alBufferAppend(bid, format, data, size, freq,
+			       &internalFormat);
 }
 
-static ALvoid _alBufferMono8(AL_buffer *buf, ALvoid *data,
-			     ALsizei size, ALsizei freq)
+/* The blocks are kept as they are and decoded by the mixer, which
+   keeps each voice's decoder state so playing on costs little. */
+ALboolean alutLoadIMA_ADPCMData_LOKI(ALuint bid, ALvoid *data, ALuint size,
+				     alIMAADPCM_state_LOKI *ias)
 {
+	alWaveFMT_LOKI *fmt = &ias->wavefmt;
+	ALboolean result = AL_FALSE;
+	AL_buffer *buf;
+	ALuint group, frames, rest;
 	ALvoid *copy;
-	ALsizei frames = size;
 
-	if (!(copy = malloc(frames << 1)))
+	if (!(buf = _alLockBuffer(bid)))
 	{
-		_alSetError(AL_OUT_OF_MEMORY);
-		return;
+		_alSetError(AL_INVALID_NAME);
+		return AL_FALSE;
 	}
 
+	if (!_alClaimBuffer(buf))
 	{
-		__uint8_t *from = data;
-		__int16_t *to = copy;
-		ALsizei i;
-
-		for (i = 0; i < frames; i++)
-		{
-			__int16_t value = (*(from++) - 128) << 8;
-			*(to++) = value;
-		}
+		_alSetError(AL_INVALID_OPERATION);
+		goto unlock;
 	}
 
-	buf->data = copy;
-	buf->size = frames;
-	buf->freq = freq;
-}
-
-static ALvoid _alBufferMono16(AL_buffer *buf, ALvoid *data,
-			     ALsizei size, ALsizei freq)
-{
-	ALvoid *copy;
-	ALsizei frames = size >> 1;
+	group = 4 * fmt->channels;
 
-	if (!(copy = malloc(frames << 1)))
+	if (fmt->encoding != _AL_WAVE_IMA_ADPCM || fmt->bitspersample != 4 ||
+	    (fmt->channels != 1 && fmt->channels != 2) ||
+	    fmt->blockalign < 2 * group || fmt->blockalign % group || !data)
 	{
-		_alSetError(AL_OUT_OF_MEMORY);
-		return;
+		_alSetError(AL_INVALID_VALUE);
+		goto unclaim;
 	}
 
-	{
-		__int16_t *from = data;
-		__int16_t *to = copy;
-		ALsizei i;
+	/* A short last block ends at its last whole group */
+	frames = size / fmt->blockalign *
+		 _alIMABlockFrames(fmt->blockalign, fmt->channels);
+	rest = size % fmt->blockalign;
 
-		for (i = 0; i < frames; i++)
-		{
-			__int16_t value = *(from++);
-			 *(to++) = value;
-		}
+	if (rest >= group)
+	{
+		frames += _alIMABlockFrames(rest - rest % group,
+					    fmt->channels);
 	}
 
-	buf->data = copy;
-	buf->size = frames;
-	buf->freq = freq;
-}
-
-static ALvoid _alBufferStereo8(AL_buffer *buf, ALvoid *data,
-			     ALsizei size, ALsizei freq)
-{
-	ALvoid *copy;
-	ALsizei frames = size >> 1;
-
-	if (!(copy = malloc(frames << 2)))
+	if (!(copy = malloc(size)))
 	{
 		_alSetError(AL_OUT_OF_MEMORY);
-		return;
+		goto unclaim;
 	}
 
-	{
-		__uint8_t *from = data;
-		__int16_t *to = copy;
-		ALsizei i;
+	memcpy(copy, data, size);
 
-		for (i = 0; i < frames; i++)
-		{
-			*(to++) = (*(from++) - 128) << 8;
-			*(to++) = (*(from++) - 128) << 8;
-		}
+	_alBeginWrite(buf);
+
+	if (!_alFreeData(buf))
+	{
+		_alEndWrite(buf);
+		free(copy);
+		goto unclaim;
 	}
 
 	buf->data = copy;
+	buf->encoding = _AL_ENCODING_IMA4;
+	buf->block = fmt->blockalign;
+	buf->block_frames = _alIMABlockFrames(fmt->blockalign, fmt->channels);
 	buf->size = frames;
-	buf->freq = freq;
-	buf->mono = AL_FALSE;
-}
+	buf->freq = fmt->frequency;
+	buf->channels = fmt->channels;
 
-static ALvoid _alBufferStereo16(AL_buffer *buf, ALvoid *data,
-				ALsizei size, ALsizei freq)
-{
-	ALvoid *copy;
-	ALsizei frames = size >> 2;
-
-	if (!(copy = malloc(frames << 2)))
-	{
-		_alSetError(AL_OUT_OF_MEMORY);
-		return;
-	}
+	_alEndWrite(buf);
 
-	{
-		__int32_t *from = data;
-		__int32_t *to = copy;
-		ALsizei i;
+	result = AL_TRUE;
 
-		for (i = 0; i < frames; i++)
-		{
-			*(to++) = *(from++);
-		}
-	}
+unclaim:
+	_alUnclaimBuffer(buf);
+unlock:
+	_alUnlockBuffer(buf);
 
-	buf->data = copy;
-	buf->size = frames;
-	buf->freq = freq;
-	buf->mono = AL_FALSE;	
+	return result;
 }
 
-ALvoid alBufferData(ALuint bid, ALenum format, ALvoid *data,
-		    ALsizei size, ALsizei freq)
+/* AL_BUFFER_DEVICE_RATE_EXT applies to the data uploaded after it */
+ALvoid alBufferi_LOKI(ALuint bid, ALenum param, ALint value)
 {
 	AL_buffer *buf;
 
@@ -347,110 +1252,128 @@ ALvoid alBufferData(ALuint bid, ALenum format, ALvoid *data,
 		return;
 	}
 
-	if (buf->used > 1)
+	switch (param)
 	{
-		_alSetError(AL_INVALID_OPERATION);
-		goto unlock;
+	case AL_BUFFER_DEVICE_RATE_EXT:
+		if (value != AL_TRUE && value != AL_FALSE)
+		{
+			_alSetError(AL_INVALID_VALUE);
+			break;
+		}
+
+		buf->device_rate = value;
+		break;
+	default:
+		_alSetError(AL_INVALID_ENUM);
+		break;
 	}
 
-	if (buf->data)
+	_alUnlockBuffer(buf);
+}
+
+/* Bytes of samples held, a short last ADPCM block counts as far as
+   its last group of eight frames and a callback holds none */
+static ALuint _alBufferBytes(AL_buffer *buf)
+{
+	if (buf->encoding == _AL_ENCODING_IMA4)
 	{
-		free(buf->data);
-		buf->data = 0;
-		buf->size = 0;
+		ALuint group = 4 * buf->channels;
+		ALuint rest = buf->size % buf->block_frames;
+
+		return buf->size / buf->block_frames * buf->block +
+			(rest ? group * (1 + (rest - 1) / 8) : 0);
 	}
 
-	switch (format)
+	if (buf->encoding == _AL_ENCODING_CALLBACK)
 	{
-	case AL_FORMAT_MONO8:
-		_alBufferMono8(buf, data, size, freq);
-		break;
-	case AL_FORMAT_MONO16:
-		_alBufferMono16(buf, data, size, freq);
-		break;
-	case AL_FORMAT_STEREO8:
-		_alBufferStereo8(buf, data, size, freq);
-		break;
-	case AL_FORMAT_STEREO16:
-		_alBufferStereo16(buf, data, size, freq);
-		break;
-	default:
-		_alSetError(AL_INVALID_ENUM);
-		break;
+		return 0;
 	}
 
-unlock:
-	    _alUnlockBuffer(buf);
+	return buf->size * buf->channels * (_alBufferBits(buf) >> 3);
 }
 
 ALvoid alGetBufferi(ALuint bid, ALenum param, ALint *value)
 {
 	AL_buffer *buf;
-
-	pthread_mutex_lock(&_al_buffer_mutex);
+	ALint v;
 
 	if (!(buf = _alFindBuffer(bid)))
 	{
 		_alSetError(AL_INVALID_NAME);
-		goto unlock;
+		return;
 	}
 
 	switch (param)
 	{
 	case AL_FREQUENCY:
-		*value = (ALint)buf->freq;
+		v = (ALint)buf->freq;
 		break;
 	case AL_BITS:
-		*value = 16;
+		v = (ALint)_alBufferBits(buf);
 		break;
 	case AL_CHANNELS:
-		*value = 2;
+		v = (ALint)buf->channels;
 		break;
 	case AL_SIZE:
-		*value = (ALint)(buf->size << 2);
+		v = (ALint)_alBufferBytes(buf);
+		break;
+	case AL_BUFFER_DEVICE_RATE_EXT:
+		v = (ALint)buf->device_rate;
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
-		break;
+		return;
 	}
 
-unlock:
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	if (!_alSameBuffer(buf, bid))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	*value = v;
 }
 
 ALvoid alGetBufferf(ALuint bid, ALenum param, ALfloat *value)
 {
 	AL_buffer *buf;
+	ALfloat v;
 
-	pthread_mutex_lock(&_al_buffer_mutex);
-
-	if (!(buf = _alLockBuffer(bid)))
+	if (!(buf = _alFindBuffer(bid)))
 	{
 		_alSetError(AL_INVALID_NAME);
-		goto unlock;
+		return;
 	}
 
 	switch (param)
 	{
 	case AL_FREQUENCY:
-		*value = (ALfloat)buf->freq;
+		v = (ALfloat)buf->freq;
 		break;
 	case AL_BITS:
-		*value = 16.0f;
+		v = (ALfloat)_alBufferBits(buf);
 		break;
 	case AL_CHANNELS:
-		*value = 2.0f;
+		v = (ALfloat)buf->channels;
 		break;
 	case AL_SIZE:
-		*value = (ALfloat)(buf->size << 2);
+		v = (ALfloat)_alBufferBytes(buf);
+		break;
+	case AL_BUFFER_DEVICE_RATE_EXT:
+		v = (ALfloat)buf->device_rate;
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
-		break;
+		return;
 	}
 
-unlock:
-	pthread_mutex_unlock(&_al_buffer_mutex);
+	if (!_alSameBuffer(buf, bid))
+	{
+		_alSetError(AL_INVALID_NAME);
+		return;
+	}
+
+	*value = v;
 }
 
 ALvoid alGetBufferiv(ALuint bid, ALenum param, ALint *values)
@@ -20,22 +20,102 @@
 #ifndef _AL_BUFFER_H_
 #define _AL_BUFFER_H_
 
+#include <stdint.h>
+
 #include <AL/al.h>
 #include <AL/alc.h>
 
+/* Ring of a streaming buffer, its size frames long.  The application
+   appends at write and the mixer plays on from read, each side only
+   moves its own count.  Frame f is kept at f modulo the size.  claimed
+   is set while a source has the buffer, a ring is only read from one
+   place. */
+typedef struct _AL_stream
+{
+	ALuint claimed;
+	uint64_t write __attribute__((aligned(64)));
+	uint64_t read __attribute__((aligned(64)));
+}
+AL_stream;
+
+struct _AL_retired;
+
 typedef struct _AL_buffer
 {	
-	struct _AL_buffer *next;
+	struct _AL_buffer *next;	/* free list */
 	ALuint id;
+	ALuint slot;
+	ALuint generation;
 	ALuint used;
+	ALuint mixing;
 	int16_t *data;
-	ALboolean mono;
-	ALuint size;
+	ALboolean borrowed;	/* data belongs to the application */
+	ALuint channels;
+	ALuint size;		/* in frames */
 	ALuint freq;
+	ALuint encoding;
+	ALuint block;		/* bytes per compressed block */
+	ALuint block_frames;
+	ALuint stamp;		/* changes with the data, odd while it does */
+	int (*callback)(ALuint, ALuint, ALshort *, ALenum, ALint, ALint);
+	AL_stream *stream;
+	ALboolean device_rate;	/* convert uploads to the device's rate */
+	ALuint rate;		/* being converted to, 0 when not */
+	struct _AL_buffer *rate_next;	/* conversion queue */
+	ALboolean rate_busy;	/* converting without the rate mutex */
+	struct _AL_retired *retired;	/* replaced while mixing */
 }
 AL_buffer;
 
+/* How the samples are stored */
+#define _AL_ENCODING_PCM16 0
+#define _AL_ENCODING_IMA4 1	/* IMA ADPCM, decoded while mixing */
+#define _AL_ENCODING_PCM8 2	/* unsigned, widened while mixing */
+#define _AL_ENCODING_FLOAT32 3
+#define _AL_ENCODING_CALLBACK 4	/* 16 bit, pulled while mixing */
+
+/* Buffer ids are a slot number plus one in the low bits and the
+   slot's generation above, so a deleted id stays invalid while its
+   slot is used again.  Slots live in chunks that are never moved or
+   freed, looking an id up needs no lock. */
+#define _AL_BUFFER_SLOT_BITS 20
+#define _AL_BUFFER_SLOT_MASK ((1 << _AL_BUFFER_SLOT_BITS) - 1)
+#define _AL_BUFFER_CHUNK_BITS 10
+#define _AL_BUFFER_CHUNK (1 << _AL_BUFFER_CHUNK_BITS)
+#define _AL_BUFFER_CHUNKS (1 << (_AL_BUFFER_SLOT_BITS - _AL_BUFFER_CHUNK_BITS))
+
 AL_buffer *_alLockBuffer(ALuint);
 ALvoid _alUnlockBuffer(AL_buffer *);
 
+/* Locked for a source to play, with its samples converted */
+AL_buffer *_alUseBuffer(ALuint);
+
+/* used counts the sources the API has bound or queued the buffer
+   to, a buffer can only be deleted while that is zero.  mixing counts
+   references held by the mixer, a buffer deleted while the mixer
+   still holds it is freed when the mixer lets go.  Both are atomic and
+   deleting sets this bit in each. */
+#define _AL_BUFFER_DEAD 0x80000000
+
+/* Set in used while an upload replaces the samples.  It only starts
+   when its own lock is the only one, whoever locks the buffer after
+   it must leave the samples alone until the bit is gone. */
+#define _AL_BUFFER_WRITING 0x40000000
+
+ALboolean _alClaimStream(AL_buffer *);
+ALvoid _alUnclaimStream(AL_buffer *);
+
+ALvoid _alRetainBuffer(AL_buffer *);
+ALvoid _alReleaseBuffer(AL_buffer *);
+
+/* A buffer's samples may be replaced while the mixer still holds it
+   from a source the API has already taken it off.  The writer makes
+   stamp odd for as long as it changes the fields, the mixer plays a
+   copy taken between two reads of the same even stamp.  Samples
+   replaced meanwhile are freed once mixing drops to zero. */
+ALvoid _alBeginWrite(AL_buffer *);
+ALvoid _alEndWrite(AL_buffer *);
+ALboolean _alDropData(AL_buffer *, ALvoid *data, AL_stream *stream);
+ALboolean _alSnapBuffer(AL_buffer *, AL_buffer *copy);
+
 #endif
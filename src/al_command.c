@@ -0,0 +1,215 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "al_command.h"
+#include "al_listener.h"
+#include "alc_context.h"
+
+#define _AL_COMMAND_MASK (_AL_COMMANDS - 1)
+
+AL_commands *_alCreateCommands(ALvoid)
+{
+	AL_commands *cmds;
+	ALuint i;
+
+	if (posix_memalign((void **)&cmds, 64, sizeof(AL_commands)))
+	{
+		return 0;
+	}
+
+	for (i = 0; i < _AL_COMMANDS; i++)
+	{
+		cmds->slot[i].sequence = i;
+	}
+
+	cmds->tail = 0;
+	cmds->head = 0;
+
+	return cmds;
+}
+
+ALvoid _alSendCommand(AL_context *ctx, AL_command *cmd)
+{
+	AL_commands *cmds = ctx->commands;
+	AL_command *slot;
+	ALuint pos, seq;
+
+	pos = __atomic_load_n(&cmds->tail, __ATOMIC_RELAXED);
+
+	for (;;)
+	{
+		slot = &cmds->slot[pos & _AL_COMMAND_MASK];
+		seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+		if (seq == pos)
+		{
+			if (__atomic_compare_exchange_n(&cmds->tail, &pos, pos + 1,
+							1, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if ((ALint)(seq - pos) < 0)
+		{
+			/* Full, only happens when a whole queue of changes
+			   is made within one period.  Without a mixer thread
+			   the caller has to drain it itself. */
+			if (ctx->thread)
+			{
+				_alcWakeContext(ctx);
+				sched_yield();
+			}
+			else
+			{
+				_alProcessCommands(ctx);
+			}
+
+			pos = __atomic_load_n(&cmds->tail, __ATOMIC_RELAXED);
+		}
+		else
+		{
+			pos = __atomic_load_n(&cmds->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->type = cmd->type;
+	slot->source = cmd->source;
+	slot->u = cmd->u;
+
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+static ALvoid _alApplyCommand(AL_context *ctx, AL_command *cmd)
+{
+	AL_source *src = cmd->source;
+
+	switch (cmd->type)
+	{
+	case _AL_CMD_ADD_SOURCE:
+		ctx->mix_sources[src->slot] = src;
+		break;
+	case _AL_CMD_DELETE_SOURCE:
+		_alDestroySource(src);
+		break;
+	case _AL_CMD_SOURCE_PARAMS:
+		src->mix_param = cmd->u.params;
+		break;
+	case _AL_CMD_SOURCE_BUFFER:
+		if (src->mix_buffer)
+		{
+			_alReleaseBuffer(src->mix_buffer);
+		}
+		src->mix_buffer = cmd->u.buffer;
+		src->decoder.buffer = 0;
+		break;
+	case _AL_CMD_SOURCE_RING:
+		/* A larger ring, already holding the entries of this one */
+		if (src->mix_queue)
+		{
+			free(src->mix_queue);
+		}
+
+		src->mix_queue = cmd->u.ring.entries;
+		src->mix_queue_mask = cmd->u.ring.mask;
+		break;
+	case _AL_CMD_SOURCE_QUEUE:
+		_alSourceQueue(src, cmd->u.queue);
+		break;
+	case _AL_CMD_SOURCE_VOICE:
+		_alcTakeVoice(src, cmd);
+		break;
+	case _AL_CMD_SOURCE_TRANSPORT:
+		_alSourceTransport(src, cmd->u.transport.state,
+				   cmd->u.transport.serial);
+		break;
+	case _AL_CMD_LISTENER:
+		{
+			AL_listener *listener = &ctx->mix_listener;
+			ALuint i;
+
+			listener->gain = cmd->u.listener.gain;
+
+			for (i = 0; i < 3; i++)
+			{
+				listener->position[i] =
+					cmd->u.listener.position[i];
+				listener->velocity[i] =
+					cmd->u.listener.velocity[i];
+			}
+
+			for (i = 0; i < 6; i++)
+			{
+				listener->orientation[i] =
+					cmd->u.listener.orientation[i];
+			}
+
+			_alListenerSetSpeakers(listener, ctx->speakers);
+		}
+		break;
+	case _AL_CMD_CONTEXT:
+		ctx->mix_doppler_factor = cmd->u.context.doppler_factor;
+		ctx->mix_doppler_velocity = cmd->u.context.doppler_velocity;
+		ctx->mix_distance_func = cmd->u.context.distance_func;
+		break;
+	case _AL_CMD_SOURCE_TABLE:
+		/* A larger table, the new slots are empty */
+		if (ctx->mix_sources)
+		{
+			memcpy(cmd->u.table.sources, ctx->mix_sources,
+			       ctx->mix_source_slots * sizeof(AL_source *));
+			free(ctx->mix_sources);
+		}
+
+		ctx->mix_sources = cmd->u.table.sources;
+		ctx->mix_source_slots = cmd->u.table.slots;
+		break;
+	}
+}
+
+ALvoid _alProcessCommands(AL_context *ctx)
+{
+	AL_commands *cmds = ctx->commands;
+	AL_command *cmd;
+	ALuint pos = cmds->head;
+	ALuint n;
+
+	/* At most one queue's worth so a busy sender can't starve mixing */
+	for (n = 0; n < _AL_COMMANDS; n++)
+	{
+		cmd = &cmds->slot[pos & _AL_COMMAND_MASK];
+
+		if (__atomic_load_n(&cmd->sequence, __ATOMIC_ACQUIRE) != pos + 1)
+		{
+			break;
+		}
+
+		_alApplyCommand(ctx, cmd);
+
+		__atomic_store_n(&cmd->sequence, pos + _AL_COMMANDS,
+				 __ATOMIC_RELEASE);
+		pos++;
+	}
+
+	cmds->head = pos;
+}
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _AL_COMMAND_H_
+#define _AL_COMMAND_H_
+
+#include <AL/al.h>
+
+#include "al_source.h"
+
+/* Changes made through the API reach the mixer as commands */
+#define _AL_CMD_ADD_SOURCE 1
+#define _AL_CMD_DELETE_SOURCE 2
+#define _AL_CMD_SOURCE_PARAMS 3
+#define _AL_CMD_SOURCE_BUFFER 4
+#define _AL_CMD_SOURCE_QUEUE 5
+#define _AL_CMD_SOURCE_TRANSPORT 6
+#define _AL_CMD_LISTENER 7
+#define _AL_CMD_CONTEXT 8
+#define _AL_CMD_SOURCE_TABLE 9
+#define _AL_CMD_SOURCE_VOICE 10
+#define _AL_CMD_SOURCE_RING 11
+
+typedef struct _AL_command
+{
+	ALuint sequence;
+	ALuint type;
+	AL_source *source;
+
+	union
+	{
+		AL_source_params params;
+		AL_buffer *buffer;
+
+		ALuint queue;
+
+		struct
+		{
+			AL_buffer **entries;
+			ALuint mask;
+		}
+		ring;
+
+		struct
+		{
+			AL_source **sources;
+			ALuint slots;
+		}
+		table;
+
+		struct
+		{
+			ALenum state;
+			ALuint serial;
+		}
+		transport;
+
+		/* The pcm of from, or one just opened when that is 0 */
+		struct
+		{
+			AL_source *from;
+			snd_pcm_t *handle;
+			ALuint freq;
+			ALuint periods;
+			snd_pcm_uframes_t buffer_size;
+			snd_pcm_uframes_t period_size;
+		}
+		voice;
+
+		struct
+		{
+			ALfloat gain;
+			ALfloat position[3];
+			ALfloat velocity[3];
+			ALfloat orientation[6];
+		}
+		listener;
+
+		struct
+		{
+			ALfloat doppler_factor;
+			ALfloat doppler_velocity;
+			ALfloat (*distance_func)(AL_source *, ALfloat);
+		}
+		context;
+	}
+	u;
+}
+AL_command;
+
+/* Bounded queue, any thread may send, only the mixer receives.  Each
+   slot's sequence says whether it is free for the sender at tail or
+   filled for the receiver at head. */
+#define _AL_COMMANDS 1024
+
+typedef struct _AL_commands
+{
+	AL_command slot[_AL_COMMANDS];
+
+	ALuint tail __attribute__((aligned(64)));
+	ALuint head __attribute__((aligned(64)));
+}
+AL_commands;
+
+struct _AL_context;
+
+AL_commands *_alCreateCommands(ALvoid);
+ALvoid _alSendCommand(struct _AL_context *, AL_command *);
+ALvoid _alProcessCommands(struct _AL_context *);
+
+#endif
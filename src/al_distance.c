@@ -23,36 +23,38 @@
 
 static ALfloat _alDistanceNone(AL_source *src, ALfloat dist ATTRIBUTE_UNUSED)
 {
-	return src->gain;
+	return src->mix_param.gain;
 }
 
 ALfloat _alDistanceInverse(AL_source *src, ALfloat dist)
 {
-	ALfloat ref = src->reference_distance;
+	AL_source_params *par = &src->mix_param;
+	ALfloat ref = par->reference_distance;
 
 	if (dist < ref)
 	{
 		dist = ref;
 	}
 
-	return src->gain * ref / (ref + src->rolloff_factor * (dist - ref));
+	return par->gain * ref / (ref + par->rolloff_factor * (dist - ref));
 }
 
 static ALfloat _alDistanceInverseClamped(AL_source *src, ALfloat dist)
 {
-	ALfloat ref = src->reference_distance;
+	AL_source_params *par = &src->mix_param;
+	ALfloat ref = par->reference_distance;
 
 	if (dist < ref)
 	{
 		dist = ref;
 	}
 
-	if (dist > src->max_distance)
+	if (dist > par->max_distance)
 	{
-		dist = src->max_distance;
+		dist = par->max_distance;
 	}
 
-	return src->gain * ref / (ref + src->rolloff_factor * (dist - ref));
+	return par->gain * ref / (ref + par->rolloff_factor * (dist - ref));
 }
 
 
@@ -88,6 +90,8 @@ ALvoid alDistanceModel(ALenum model)
 	ctx->distance_model = model;
 	ctx->distance_func = df;
 
+	_alSendContext(ctx);
+
 unlock:
 	_alcUnlockContext(ctx);
 }
@@ -34,6 +34,8 @@ ALvoid alDopplerFactor(ALfloat value)
 
 	_alRangedAssign1(ctx->doppler_factor, value, 0.0f);
 
+	_alSendContext(ctx);
+
 	_alcUnlockContext(ctx);
 }
 
@@ -51,5 +53,7 @@ ALvoid alDopplerVelocity(ALfloat value)
 
 	_alRangedAssign1(ctx->doppler_velocity, value, 0.0f);
 
+	_alSendContext(ctx);
+
 	_alcUnlockContext(ctx);
 }
@@ -22,8 +22,7 @@
 #include "al_vector.h"
 #include "alc_context.h"
 
-static ALvoid _alListenerSetSpeakers(AL_listener *listener,
-				     AL_speaker *speakers)
+ALvoid _alListenerSetSpeakers(AL_listener *listener, AL_speaker *speakers)
 {
 	ALfloat matrix[9];
 	ALuint i;
@@ -74,6 +73,30 @@ ALvoid _alInitListener(AL_listener *listener, AL_speaker *speakers)
 	_alListenerSetSpeakers(listener, speakers);
 }
 
+/* Hand the listener over to the mixer, which works out the speakers */
+static ALvoid _alSendListener(AL_context *ctx)
+{
+	AL_command cmd;
+	ALuint i;
+
+	cmd.type = _AL_CMD_LISTENER;
+	cmd.source = 0;
+	cmd.u.listener.gain = ctx->listener.gain;
+
+	for (i = 0; i < 3; i++)
+	{
+		cmd.u.listener.position[i] = ctx->listener.position[i];
+		cmd.u.listener.velocity[i] = ctx->listener.velocity[i];
+	}
+
+	for (i = 0; i < 6; i++)
+	{
+		cmd.u.listener.orientation[i] = ctx->listener.orientation[i];
+	}
+
+	_alSendCommand(ctx, &cmd);
+}
+
 ALvoid alListeneri(ALenum pname, ALint value)
 {
 	alListenerf(pname, (ALfloat)value);
@@ -101,6 +124,8 @@ ALvoid alListenerf(ALenum pname, ALfloat value)
 		break;
 	}
 
+	_alSendListener(ctx);
+
 	_alcUnlockContext(ctx);
 }
 
@@ -133,6 +158,8 @@ ALvoid alListener3f(ALenum pname, ALfloat f1, ALfloat f2, ALfloat f3)
 		break;
 	}
 
+	_alSendListener(ctx);
+
 	_alcUnlockContext(ctx);
 }
 
@@ -171,13 +198,14 @@ ALvoid alListenerfv(ALenum pname, ALfloat* values)
 		ctx->listener.orientation[3] = values[3];
 		ctx->listener.orientation[4] = values[4];
 		ctx->listener.orientation[5] = values[5];
-		_alListenerSetSpeakers(&ctx->listener, ctx->speakers);
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
 	}
 
+	_alSendListener(ctx);
+
 	_alcUnlockContext(ctx);
 }
 
@@ -33,5 +33,6 @@ typedef struct _AL_listener {
 } AL_listener;
 
 extern ALvoid _alInitListener(AL_listener *, AL_speaker *);
+extern ALvoid _alListenerSetSpeakers(AL_listener *, AL_speaker *);
 
 #endif
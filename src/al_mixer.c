@@ -0,0 +1,1182 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define _AL_MIX_X86
+#include <immintrin.h>
+#endif
+
+#include "al_mixer.h"
+
+/* Plain C kernels, used on every cpu and for the tails of the
+   vector loops. */
+
+static ALvoid _alMixGainC(ALfloat *dst, const ALfloat *src,
+			  ALfloat gain, ALuint n)
+{
+	ALuint i;
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] += src[i] * gain;
+	}
+}
+
+static ALvoid _alMixPanC(ALfloat **dst, ALuint channels,
+			 const ALfloat *src, const ALfloat *gains, ALuint n)
+{
+	ALuint c;
+
+	for (c = 0; c < channels; c++)
+	{
+		_alMixGainC(dst[c], src, gains[c], n);
+	}
+}
+
+static ALvoid _alMixOutputC(ALshort *dst, ALuint stride,
+			    const ALfloat *src, ALuint n)
+{
+	ALuint i;
+
+	for (i = 0; i < n; i++)
+	{
+		ALfloat value = src[i];
+
+		if (value >= 32767.0f)
+			*dst = 32767;
+		else if (value <= -32768.0f)
+			*dst = -32768;
+		else
+			*dst = (ALshort)lrintf(value);
+
+		dst += stride;
+	}
+}
+
+static ALvoid _alMixLoad16C(ALfloat **dst, ALuint channels,
+			    const ALshort *src, ALuint n)
+{
+	ALuint i, c;
+
+	for (c = 0; c < channels; c++)
+	{
+		ALfloat *d = dst[c];
+		const ALshort *s = src + c;
+
+		for (i = 0; i < n; i++)
+		{
+			d[i] = *s;
+			s += channels;
+		}
+	}
+}
+
+/* Unsigned 8 bit samples widen to the 16 bit scale */
+static ALvoid _alMixLoad8C(ALfloat **dst, ALuint channels,
+			   const ALubyte *src, ALuint n)
+{
+	ALuint i, c;
+
+	for (c = 0; c < channels; c++)
+	{
+		ALfloat *d = dst[c];
+		const ALubyte *s = src + c;
+
+		for (i = 0; i < n; i++)
+		{
+			d[i] = (ALfloat)(((ALint)*s - 128) << 8);
+			s += channels;
+		}
+	}
+}
+
+static ALvoid _alMixLoadFloatC(ALfloat **dst, ALuint channels,
+			       const ALfloat *src, ALuint n)
+{
+	ALuint i, c;
+
+	for (c = 0; c < channels; c++)
+	{
+		ALfloat *d = dst[c];
+		const ALfloat *s = src + c;
+
+		for (i = 0; i < n; i++)
+		{
+			d[i] = *s * 32768.0f;
+			s += channels;
+		}
+	}
+}
+
+/* Upload conversions, n samples whatever the channels */
+static ALvoid _alConvertWiden8C(ALshort *dst, const ALubyte *src, ALuint n)
+{
+	ALuint i;
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] = (ALshort)(((ALint)src[i] - 128) << 8);
+	}
+}
+
+static ALvoid _alConvertNarrow16C(ALubyte *dst, const ALshort *src, ALuint n)
+{
+	ALuint i;
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] = (ALubyte)((src[i] >> 8) + 128);
+	}
+}
+
+static ALvoid _alConvertSwap16C(ALshort *dst, const ALshort *src, ALuint n)
+{
+	ALuint i;
+
+	for (i = 0; i < n; i++)
+	{
+		ALushort v = (ALushort)src[i];
+
+		dst[i] = (ALshort)((v << 8) | (v >> 8));
+	}
+}
+
+/* The top 24 bits of the fraction convert to float exactly */
+#define _alFracFloat(f) ((ALfloat)((ALuint)(f) >> 8) * (1.0f / 16777216.0f))
+
+static ALvoid _alResampleNearestC(ALfloat *dst, const ALfloat *src,
+				  ALuint frac, uint64_t step, ALuint n)
+{
+	uint64_t pos = frac;
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] = src[pos >> _AL_FRAC_BITS];
+		pos += step;
+	}
+}
+
+static ALvoid _alResampleLinearC(ALfloat *dst, const ALfloat *src,
+				 ALuint frac, uint64_t step, ALuint n)
+{
+	uint64_t pos = frac;
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		const ALfloat *s = src + (pos >> _AL_FRAC_BITS);
+		ALfloat f = _alFracFloat(pos);
+
+		dst[i] = s[0] + (s[1] - s[0]) * f;
+		pos += step;
+	}
+}
+
+/* Catmull-Rom spline through s[-1], s[0], s[1] and s[2] */
+#define _alCubic(a, b, c, d, f) \
+	((b) + 0.5f * (f) * ((c) - (a) + (f) * (2.0f * (a) - 5.0f * (b) + \
+	 4.0f * (c) - (d) + (f) * (3.0f * ((b) - (c)) + (d) - (a)))))
+
+static ALvoid _alResampleCubicC(ALfloat *dst, const ALfloat *src,
+				ALuint frac, uint64_t step, ALuint n)
+{
+	uint64_t pos = frac;
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		const ALfloat *s = src + (pos >> _AL_FRAC_BITS);
+		ALfloat f = _alFracFloat(pos);
+
+		dst[i] = _alCubic(s[-1], s[0], s[1], s[2], f);
+		pos += step;
+	}
+}
+
+/* Vector kernels finish the last few frames with the C ones */
+#define _alResampleTail(func, dst, src, frac, step, i, n) \
+	do { \
+		uint64_t _p = (frac) + (uint64_t)(i) * (step); \
+		func((dst) + (i), (src) + (_p >> _AL_FRAC_BITS), \
+		     (ALuint)_p, (step), (n) - (i)); \
+	} while (0)
+
+#ifdef _AL_MIX_X86
+
+__attribute__((target("sse2")))
+static ALvoid _alMixGainSSE2(ALfloat *dst, const ALfloat *src,
+			     ALfloat gain, ALuint n)
+{
+	__m128 g = _mm_set1_ps(gain);
+	ALuint i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 d = _mm_loadu_ps(dst + i);
+		__m128 s = _mm_loadu_ps(src + i);
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+	}
+
+	_alMixGainC(dst + i, src + i, gain, n - i);
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alMixPanSSE2(ALfloat **dst, ALuint channels,
+			    const ALfloat *src, const ALfloat *gains, ALuint n)
+{
+	ALuint i, c;
+
+	/* Load each source block once and spread it over the speakers */
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 s = _mm_loadu_ps(src + i);
+
+		for (c = 0; c < channels; c++)
+		{
+			__m128 d = _mm_loadu_ps(dst[c] + i);
+			__m128 g = _mm_set1_ps(gains[c]);
+
+			_mm_storeu_ps(dst[c] + i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+		}
+	}
+
+	for (c = 0; c < channels; c++)
+	{
+		_alMixGainC(dst[c] + i, src + i, gains[c], n - i);
+	}
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alMixOutputSSE2(ALshort *dst, ALuint stride,
+			       const ALfloat *src, ALuint n)
+{
+	__m128 max = _mm_set1_ps(32767.0f);
+	__m128 min = _mm_set1_ps(-32768.0f);
+	ALuint i;
+
+	/* Clamp first so huge values can't wrap in the int conversion */
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), min), max);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), min),
+				      max);
+		__m128i lo = _mm_cvtps_epi32(a);
+		__m128i hi = _mm_cvtps_epi32(b);
+		__m128i s16 = _mm_packs_epi32(lo, hi);
+
+		if (stride == 1)
+		{
+			_mm_storeu_si128((__m128i *)(dst + i), s16);
+		}
+		else
+		{
+			ALshort tmp[8] __attribute__((aligned(16)));
+			ALshort *d = dst + i * stride;
+			ALuint j;
+
+			_mm_store_si128((__m128i *)tmp, s16);
+
+			for (j = 0; j < 8; j++)
+			{
+				*d = tmp[j];
+				d += stride;
+			}
+		}
+	}
+
+	_alMixOutputC(dst + i * stride, stride, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alMixLoad16SSE2(ALfloat **dst, ALuint channels,
+			       const ALshort *src, ALuint n)
+{
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+			_mm_storeu_ps(d + i, _mm_cvtepi32_ps(lo));
+			_mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(hi));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		/* Each 32 bit lane holds one frame, split it with shifts */
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+
+			_mm_storeu_ps(l + i, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_slli_epi32(x, 16), 16)));
+			_mm_storeu_ps(r + i, _mm_cvtepi32_ps(_mm_srai_epi32(x, 16)));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoad16C(d, channels, src + i * channels, n - i);
+	}
+}
+
+/* Flipping the top bit makes the samples signed, unpacking them
+   into the high byte of each word widens them to 16 bit */
+__attribute__((target("sse2")))
+static ALvoid _alMixLoad8SSE2(ALfloat **dst, ALuint channels,
+			      const ALubyte *src, ALuint n)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	const __m128i zero = _mm_setzero_si128();
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 16 <= n; i += 16)
+		{
+			__m128i x = _mm_xor_si128(bias,
+				_mm_loadu_si128((const __m128i *)(src + i)));
+			__m128i lo = _mm_unpacklo_epi8(zero, x);
+			__m128i hi = _mm_unpackhi_epi8(zero, x);
+
+			_mm_storeu_ps(d + i, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+			_mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+			_mm_storeu_ps(d + i + 8, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+			_mm_storeu_ps(d + i + 12, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		/* Once widened each 32 bit lane holds one frame */
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i x = _mm_xor_si128(bias,
+				_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+			__m128i lo = _mm_unpacklo_epi8(zero, x);
+			__m128i hi = _mm_unpackhi_epi8(zero, x);
+
+			_mm_storeu_ps(l + i, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16)));
+			_mm_storeu_ps(r + i, _mm_cvtepi32_ps(_mm_srai_epi32(lo, 16)));
+			_mm_storeu_ps(l + i + 4, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_slli_epi32(hi, 16), 16)));
+			_mm_storeu_ps(r + i + 4,
+				      _mm_cvtepi32_ps(_mm_srai_epi32(hi, 16)));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoad8C(d, channels, src + i * channels, n - i);
+	}
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alMixLoadFloatSSE2(ALfloat **dst, ALuint channels,
+				  const ALfloat *src, ALuint n)
+{
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 4 <= n; i += 4)
+		{
+			_mm_storeu_ps(d + i, _mm_mul_ps(scale,
+				      _mm_loadu_ps(src + i)));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(src + 2 * i);
+			__m128 b = _mm_loadu_ps(src + 2 * i + 4);
+
+			_mm_storeu_ps(l + i, _mm_mul_ps(scale,
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+			_mm_storeu_ps(r + i, _mm_mul_ps(scale,
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoadFloatC(d, channels, src + i * channels, n - i);
+	}
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alConvertWiden8SSE2(ALshort *dst, const ALubyte *src, ALuint n)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	const __m128i zero = _mm_setzero_si128();
+	ALuint i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i x = _mm_xor_si128(bias,
+			_mm_loadu_si128((const __m128i *)(src + i)));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(zero, x));
+		_mm_storeu_si128((__m128i *)(dst + i + 8),
+				 _mm_unpackhi_epi8(zero, x));
+	}
+
+	_alConvertWiden8C(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alConvertNarrow16SSE2(ALubyte *dst, const ALshort *src, ALuint n)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	ALuint i = 0;
+
+	/* The high bytes fit a signed byte, packing can't saturate */
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(bias,
+			_mm_packs_epi16(_mm_srai_epi16(a, 8),
+					_mm_srai_epi16(b, 8))));
+	}
+
+	_alConvertNarrow16C(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alConvertSwap16SSE2(ALshort *dst, const ALshort *src, ALuint n)
+{
+	ALuint i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_or_si128(_mm_slli_epi16(x, 8),
+					      _mm_srli_epi16(x, 8)));
+	}
+
+	_alConvertSwap16C(dst + i, src + i, n - i);
+}
+
+/* Split four 32.32 positions into integer frames and float fractions */
+__attribute__((target("sse2")))
+static inline __m128 _alPositionsSSE2(__m128i p01, __m128i p23, ALint *idx)
+{
+	__m128 a = _mm_castsi128_ps(p01);
+	__m128 b = _mm_castsi128_ps(p23);
+	__m128i lo = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+
+	_mm_store_si128((__m128i *)idx,
+			_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(lo, 8)),
+			  _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+#define _alGatherSSE2(s, idx, o) \
+	_mm_set_ps((s)[(idx)[3] + (o)], (s)[(idx)[2] + (o)], \
+		   (s)[(idx)[1] + (o)], (s)[(idx)[0] + (o)])
+
+__attribute__((target("sse2")))
+static ALvoid _alResampleNearestSSE2(ALfloat *dst, const ALfloat *src,
+				     ALuint frac, uint64_t step, ALuint n)
+{
+	__m128i p01 = _mm_set_epi64x(frac + step, frac);
+	__m128i p23 = _mm_set_epi64x(frac + 3 * step, frac + 2 * step);
+	__m128i inc = _mm_set1_epi64x(4 * step);
+	ALint idx[4] __attribute__((aligned(16)));
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		_alPositionsSSE2(p01, p23, idx);
+
+		_mm_storeu_ps(dst + i, _alGatherSSE2(src, idx, 0));
+
+		p01 = _mm_add_epi64(p01, inc);
+		p23 = _mm_add_epi64(p23, inc);
+	}
+
+	_alResampleTail(_alResampleNearestC, dst, src, frac, step, i, n);
+}
+
+__attribute__((target("sse2")))
+static ALvoid _alResampleLinearSSE2(ALfloat *dst, const ALfloat *src,
+				    ALuint frac, uint64_t step, ALuint n)
+{
+	__m128i p01 = _mm_set_epi64x(frac + step, frac);
+	__m128i p23 = _mm_set_epi64x(frac + 3 * step, frac + 2 * step);
+	__m128i inc = _mm_set1_epi64x(4 * step);
+	ALint idx[4] __attribute__((aligned(16)));
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 f = _alPositionsSSE2(p01, p23, idx);
+		__m128 s0 = _alGatherSSE2(src, idx, 0);
+		__m128 s1 = _alGatherSSE2(src, idx, 1);
+
+		_mm_storeu_ps(dst + i,
+			      _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), f)));
+
+		p01 = _mm_add_epi64(p01, inc);
+		p23 = _mm_add_epi64(p23, inc);
+	}
+
+	_alResampleTail(_alResampleLinearC, dst, src, frac, step, i, n);
+}
+
+/* Catmull-Rom on four lanes, same expression as _alCubic */
+#define _alCubicVec(pre, a, b, c, d, f) \
+	pre##_add_ps(b, pre##_mul_ps(pre##_mul_ps(half, f), \
+	pre##_add_ps(pre##_sub_ps(c, a), pre##_mul_ps(f, \
+	pre##_add_ps(pre##_sub_ps(pre##_add_ps(pre##_sub_ps( \
+		pre##_mul_ps(two, a), pre##_mul_ps(five, b)), \
+		pre##_mul_ps(four, c)), d), \
+	pre##_mul_ps(f, pre##_sub_ps(pre##_add_ps(pre##_mul_ps(three, \
+		pre##_sub_ps(b, c)), d), a)))))))
+
+__attribute__((target("sse2")))
+static ALvoid _alResampleCubicSSE2(ALfloat *dst, const ALfloat *src,
+				   ALuint frac, uint64_t step, ALuint n)
+{
+	__m128i p01 = _mm_set_epi64x(frac + step, frac);
+	__m128i p23 = _mm_set_epi64x(frac + 3 * step, frac + 2 * step);
+	__m128i inc = _mm_set1_epi64x(4 * step);
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 three = _mm_set1_ps(3.0f);
+	__m128 four = _mm_set1_ps(4.0f);
+	__m128 five = _mm_set1_ps(5.0f);
+	ALint idx[4] __attribute__((aligned(16)));
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 f = _alPositionsSSE2(p01, p23, idx);
+		__m128 a = _alGatherSSE2(src, idx, -1);
+		__m128 b = _alGatherSSE2(src, idx, 0);
+		__m128 c = _alGatherSSE2(src, idx, 1);
+		__m128 d = _alGatherSSE2(src, idx, 2);
+
+		_mm_storeu_ps(dst + i, _alCubicVec(_mm, a, b, c, d, f));
+
+		p01 = _mm_add_epi64(p01, inc);
+		p23 = _mm_add_epi64(p23, inc);
+	}
+
+	_alResampleTail(_alResampleCubicC, dst, src, frac, step, i, n);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixGainAVX2(ALfloat *dst, const ALfloat *src,
+			     ALfloat gain, ALuint n)
+{
+	__m256 g = _mm256_set1_ps(gain);
+	ALuint i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256 d = _mm256_loadu_ps(dst + i);
+		__m256 s = _mm256_loadu_ps(src + i);
+
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(s, g)));
+	}
+
+	_alMixGainC(dst + i, src + i, gain, n - i);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixPanAVX2(ALfloat **dst, ALuint channels,
+			    const ALfloat *src, const ALfloat *gains, ALuint n)
+{
+	ALuint i, c;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256 s = _mm256_loadu_ps(src + i);
+
+		for (c = 0; c < channels; c++)
+		{
+			__m256 d = _mm256_loadu_ps(dst[c] + i);
+			__m256 g = _mm256_set1_ps(gains[c]);
+
+			_mm256_storeu_ps(dst[c] + i,
+					 _mm256_add_ps(d, _mm256_mul_ps(s, g)));
+		}
+	}
+
+	for (c = 0; c < channels; c++)
+	{
+		_alMixGainC(dst[c] + i, src + i, gains[c], n - i);
+	}
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixOutputAVX2(ALshort *dst, ALuint stride,
+			       const ALfloat *src, ALuint n)
+{
+	__m256 max = _mm256_set1_ps(32767.0f);
+	__m256 min = _mm256_set1_ps(-32768.0f);
+	ALuint i;
+
+	for (i = 0; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i),
+						       min), max);
+		__m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8),
+						       min), max);
+		__m256i lo = _mm256_cvtps_epi32(a);
+		__m256i hi = _mm256_cvtps_epi32(b);
+		/* packs works per 128 bit lane, put the quads back in order */
+		__m256i s16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi),
+						       0xD8);
+
+		if (stride == 1)
+		{
+			_mm256_storeu_si256((__m256i *)(dst + i), s16);
+		}
+		else
+		{
+			ALshort tmp[16] __attribute__((aligned(32)));
+			ALshort *d = dst + i * stride;
+			ALuint j;
+
+			_mm256_store_si256((__m256i *)tmp, s16);
+
+			for (j = 0; j < 16; j++)
+			{
+				*d = tmp[j];
+				d += stride;
+			}
+		}
+	}
+
+	_alMixOutputSSE2(dst + i * stride, stride, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixLoad16AVX2(ALfloat **dst, ALuint channels,
+			       const ALshort *src, ALuint n)
+{
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+			_mm256_storeu_ps(d + i,
+					 _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+
+			_mm256_storeu_ps(l + i, _mm256_cvtepi32_ps(
+				_mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16)));
+			_mm256_storeu_ps(r + i,
+					 _mm256_cvtepi32_ps(_mm256_srai_epi32(x, 16)));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoad16SSE2(d, channels, src + i * channels, n - i);
+	}
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixLoad8AVX2(ALfloat **dst, ALuint channels,
+			      const ALubyte *src, ALuint n)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i x = _mm_xor_si128(bias,
+				_mm_loadl_epi64((const __m128i *)(src + i)));
+
+			_mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(
+				_mm256_slli_epi32(_mm256_cvtepi8_epi32(x), 8)));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i x = _mm_xor_si128(bias,
+				_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+			__m256i w = _mm256_slli_epi16(_mm256_cvtepi8_epi16(x), 8);
+
+			_mm256_storeu_ps(l + i, _mm256_cvtepi32_ps(
+				_mm256_srai_epi32(_mm256_slli_epi32(w, 16), 16)));
+			_mm256_storeu_ps(r + i,
+					 _mm256_cvtepi32_ps(_mm256_srai_epi32(w, 16)));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoad8SSE2(d, channels, src + i * channels, n - i);
+	}
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alMixLoadFloatAVX2(ALfloat **dst, ALuint channels,
+				  const ALfloat *src, ALuint n)
+{
+	const __m256 scale = _mm256_set1_ps(32768.0f);
+	ALuint i = 0;
+
+	if (channels == 1)
+	{
+		ALfloat *d = dst[0];
+
+		for (; i + 8 <= n; i += 8)
+		{
+			_mm256_storeu_ps(d + i, _mm256_mul_ps(scale,
+					 _mm256_loadu_ps(src + i)));
+		}
+	}
+	else if (channels == 2)
+	{
+		ALfloat *l = dst[0];
+		ALfloat *r = dst[1];
+
+		/* The shuffles work within halves, which leaves the
+		   frames in 0 1 4 5 2 3 6 7 order */
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 a = _mm256_loadu_ps(src + 2 * i);
+			__m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+			__m256 x = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 y = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+			x = _mm256_castpd_ps(_mm256_permute4x64_pd(
+				_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)));
+			y = _mm256_castpd_ps(_mm256_permute4x64_pd(
+				_mm256_castps_pd(y), _MM_SHUFFLE(3, 1, 2, 0)));
+
+			_mm256_storeu_ps(l + i, _mm256_mul_ps(scale, x));
+			_mm256_storeu_ps(r + i, _mm256_mul_ps(scale, y));
+		}
+	}
+
+	if (i < n)
+	{
+		ALfloat *d[_AL_MAX_LOAD];
+		ALuint c;
+
+		for (c = 0; c < channels; c++)
+		{
+			d[c] = dst[c] + i;
+		}
+
+		_alMixLoadFloatSSE2(d, channels, src + i * channels, n - i);
+	}
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alConvertWiden8AVX2(ALshort *dst, const ALubyte *src, ALuint n)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	ALuint i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i x = _mm_xor_si128(bias,
+			_mm_loadu_si128((const __m128i *)(src + i)));
+
+		_mm256_storeu_si256((__m256i *)(dst + i),
+			_mm256_slli_epi16(_mm256_cvtepi8_epi16(x), 8));
+	}
+
+	_alConvertWiden8SSE2(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alConvertNarrow16AVX2(ALubyte *dst, const ALshort *src, ALuint n)
+{
+	const __m256i bias = _mm256_set1_epi8((char)0x80);
+	ALuint i = 0;
+
+	/* Packing works within each half, put the quarters back in order */
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+		__m256i x = _mm256_packs_epi16(_mm256_srai_epi16(a, 8),
+					       _mm256_srai_epi16(b, 8));
+
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(bias,
+			_mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 1, 2, 0))));
+	}
+
+	_alConvertNarrow16SSE2(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alConvertSwap16AVX2(ALshort *dst, const ALshort *src, ALuint n)
+{
+	ALuint i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_or_si256(_mm256_slli_epi16(x, 8),
+						    _mm256_srli_epi16(x, 8)));
+	}
+
+	_alConvertSwap16SSE2(dst + i, src + i, n - i);
+}
+
+/* Same split for eight positions held in two registers of four */
+__attribute__((target("avx2")))
+static inline __m256 _alPositionsAVX2(__m256i p0, __m256i p1, __m256i *idx)
+{
+	__m256 a = _mm256_castsi256_ps(p0);
+	__m256 b = _mm256_castsi256_ps(p1);
+	__m256i hi = _mm256_castps_si256(_mm256_shuffle_ps(a, b,
+						_MM_SHUFFLE(3, 1, 3, 1)));
+	__m256i lo = _mm256_castps_si256(_mm256_shuffle_ps(a, b,
+						_MM_SHUFFLE(2, 0, 2, 0)));
+
+	/* The shuffle works per 128 bit lane, restore frame order */
+	*idx = _mm256_permute4x64_epi64(hi, 0xD8);
+	lo = _mm256_permute4x64_epi64(lo, 0xD8);
+
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(lo, 8)),
+			     _mm256_set1_ps(1.0f / 16777216.0f));
+}
+
+#define _alPositionsInitAVX2(p0, p1, inc, frac, step) \
+	do { \
+		uint64_t _f = (frac); \
+		p0 = _mm256_set_epi64x(_f + 3 * (step), _f + 2 * (step), \
+				       _f + (step), _f); \
+		p1 = _mm256_add_epi64(p0, _mm256_set1_epi64x(4 * (step))); \
+		inc = _mm256_set1_epi64x(8 * (step)); \
+	} while (0)
+
+__attribute__((target("avx2")))
+static ALvoid _alResampleNearestAVX2(ALfloat *dst, const ALfloat *src,
+				     ALuint frac, uint64_t step, ALuint n)
+{
+	__m256i p0, p1, inc, idx;
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	_alPositionsInitAVX2(p0, p1, inc, frac, step);
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		_alPositionsAVX2(p0, p1, &idx);
+
+		_mm256_storeu_ps(dst + i, _mm256_i32gather_ps(src, idx, 4));
+
+		p0 = _mm256_add_epi64(p0, inc);
+		p1 = _mm256_add_epi64(p1, inc);
+	}
+
+	_alResampleTail(_alResampleNearestC, dst, src, frac, step, i, n);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alResampleLinearAVX2(ALfloat *dst, const ALfloat *src,
+				    ALuint frac, uint64_t step, ALuint n)
+{
+	__m256i p0, p1, inc, idx;
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	_alPositionsInitAVX2(p0, p1, inc, frac, step);
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256 f = _alPositionsAVX2(p0, p1, &idx);
+		__m256 s0 = _mm256_i32gather_ps(src, idx, 4);
+		__m256 s1 = _mm256_i32gather_ps(src + 1, idx, 4);
+
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(s0,
+				 _mm256_mul_ps(_mm256_sub_ps(s1, s0), f)));
+
+		p0 = _mm256_add_epi64(p0, inc);
+		p1 = _mm256_add_epi64(p1, inc);
+	}
+
+	_alResampleTail(_alResampleLinearC, dst, src, frac, step, i, n);
+}
+
+__attribute__((target("avx2")))
+static ALvoid _alResampleCubicAVX2(ALfloat *dst, const ALfloat *src,
+				   ALuint frac, uint64_t step, ALuint n)
+{
+	__m256i p0, p1, inc, idx;
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 two = _mm256_set1_ps(2.0f);
+	__m256 three = _mm256_set1_ps(3.0f);
+	__m256 four = _mm256_set1_ps(4.0f);
+	__m256 five = _mm256_set1_ps(5.0f);
+	ALuint i;
+
+	if (step == _AL_FRAC_ONE && !frac)
+	{
+		memcpy(dst, src, n * sizeof(ALfloat));
+		return;
+	}
+
+	_alPositionsInitAVX2(p0, p1, inc, frac, step);
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256 f = _alPositionsAVX2(p0, p1, &idx);
+		__m256 a = _mm256_i32gather_ps(src - 1, idx, 4);
+		__m256 b = _mm256_i32gather_ps(src, idx, 4);
+		__m256 c = _mm256_i32gather_ps(src + 1, idx, 4);
+		__m256 d = _mm256_i32gather_ps(src + 2, idx, 4);
+
+		_mm256_storeu_ps(dst + i, _alCubicVec(_mm256, a, b, c, d, f));
+
+		p0 = _mm256_add_epi64(p0, inc);
+		p1 = _mm256_add_epi64(p1, inc);
+	}
+
+	_alResampleTail(_alResampleCubicC, dst, src, frac, step, i, n);
+}
+
+#endif
+
+ALvoid (*_alMixGain)(ALfloat *, const ALfloat *, ALfloat, ALuint) =
+	_alMixGainC;
+ALvoid (*_alMixPan)(ALfloat **, ALuint, const ALfloat *, const ALfloat *,
+		    ALuint) = _alMixPanC;
+ALvoid (*_alMixOutput)(ALshort *, ALuint, const ALfloat *, ALuint) =
+	_alMixOutputC;
+ALvoid (*_alMixLoad16)(ALfloat **, ALuint, const ALshort *, ALuint) =
+	_alMixLoad16C;
+ALvoid (*_alMixLoad8)(ALfloat **, ALuint, const ALubyte *, ALuint) =
+	_alMixLoad8C;
+ALvoid (*_alMixLoadFloat)(ALfloat **, ALuint, const ALfloat *, ALuint) =
+	_alMixLoadFloatC;
+ALvoid (*_alConvertWiden8)(ALshort *, const ALubyte *, ALuint) =
+	_alConvertWiden8C;
+ALvoid (*_alConvertNarrow16)(ALubyte *, const ALshort *, ALuint) =
+	_alConvertNarrow16C;
+ALvoid (*_alConvertSwap16)(ALshort *, const ALshort *, ALuint) =
+	_alConvertSwap16C;
+ALvoid (*_alResample[_AL_RESAMPLERS])(ALfloat *, const ALfloat *, ALuint,
+				      uint64_t, ALuint) =
+{
+	_alResampleNearestC,
+	_alResampleLinearC,
+	_alResampleCubicC
+};
+
+static const char *_al_mixer_name = "C";
+static pthread_once_t _al_mixer_once = PTHREAD_ONCE_INIT;
+
+static ALvoid _alMixerSelect(ALvoid)
+{
+#ifdef _AL_MIX_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		_alMixGain = _alMixGainAVX2;
+		_alMixPan = _alMixPanAVX2;
+		_alMixOutput = _alMixOutputAVX2;
+		_alMixLoad16 = _alMixLoad16AVX2;
+		_alMixLoad8 = _alMixLoad8AVX2;
+		_alMixLoadFloat = _alMixLoadFloatAVX2;
+		_alConvertWiden8 = _alConvertWiden8AVX2;
+		_alConvertNarrow16 = _alConvertNarrow16AVX2;
+		_alConvertSwap16 = _alConvertSwap16AVX2;
+		_alResample[_AL_RESAMPLE_NEAREST] = _alResampleNearestAVX2;
+		_alResample[_AL_RESAMPLE_LINEAR] = _alResampleLinearAVX2;
+		_alResample[_AL_RESAMPLE_CUBIC] = _alResampleCubicAVX2;
+		_al_mixer_name = "AVX2";
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		_alMixGain = _alMixGainSSE2;
+		_alMixPan = _alMixPanSSE2;
+		_alMixOutput = _alMixOutputSSE2;
+		_alMixLoad16 = _alMixLoad16SSE2;
+		_alMixLoad8 = _alMixLoad8SSE2;
+		_alMixLoadFloat = _alMixLoadFloatSSE2;
+		_alConvertWiden8 = _alConvertWiden8SSE2;
+		_alConvertNarrow16 = _alConvertNarrow16SSE2;
+		_alConvertSwap16 = _alConvertSwap16SSE2;
+		_alResample[_AL_RESAMPLE_NEAREST] = _alResampleNearestSSE2;
+		_alResample[_AL_RESAMPLE_LINEAR] = _alResampleLinearSSE2;
+		_alResample[_AL_RESAMPLE_CUBIC] = _alResampleCubicSSE2;
+		_al_mixer_name = "SSE2";
+	}
+#endif
+}
+
+ALvoid _alMixerInit(ALvoid)
+{
+	pthread_once(&_al_mixer_once, _alMixerSelect);
+}
+
+const char *_alMixerName(ALvoid)
+{
+	return _al_mixer_name;
+}
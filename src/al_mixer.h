@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _AL_MIXER_H_
+#define _AL_MIXER_H_
+
+#include <stdint.h>
+
+#include <AL/al.h>
+
+/* Mix bus lines are padded to this many floats and aligned for AVX */
+#define _AL_MIX_ALIGN 8
+
+#define _alMixAlign(n) (((n) + _AL_MIX_ALIGN - 1) & ~(_AL_MIX_ALIGN - 1))
+
+/* dst[i] += src[i] * gain */
+extern ALvoid (*_alMixGain)(ALfloat *dst, const ALfloat *src,
+			    ALfloat gain, ALuint n);
+
+/* dst[c][i] += src[i] * gains[c] for every output channel */
+extern ALvoid (*_alMixPan)(ALfloat **dst, ALuint channels,
+			   const ALfloat *src, const ALfloat *gains, ALuint n);
+
+/* dst[i * stride] = saturate(src[i]) */
+extern ALvoid (*_alMixOutput)(ALshort *dst, ALuint stride,
+			      const ALfloat *src, ALuint n);
+
+/* Source positions are 32.32 fixed point frames */
+#define _AL_FRAC_BITS 32
+#define _AL_FRAC_ONE ((uint64_t)1 << _AL_FRAC_BITS)
+#define _AL_FRAC_MASK (_AL_FRAC_ONE - 1)
+
+/* Interpolators, the value is also the index into _alResample */
+#define _AL_RESAMPLE_NEAREST 0
+#define _AL_RESAMPLE_LINEAR 1
+#define _AL_RESAMPLE_CUBIC 2
+#define _AL_RESAMPLERS 3
+
+/* Frames an interpolator reads before and after the one it is at */
+#define _AL_RESAMPLE_PRE 1
+#define _AL_RESAMPLE_POST 2
+
+/* dst[i] = interpolate(src, frac + i * step), src[-1] to src[n + 2]
+   of the span covered must be readable. */
+extern ALvoid (*_alResample[_AL_RESAMPLERS])(ALfloat *dst, const ALfloat *src,
+					     ALuint frac, uint64_t step,
+					     ALuint n);
+
+/* Most channels a buffer frame can have */
+#define _AL_MAX_LOAD 8
+
+/* Deinterleave n frames of signed 16 bit samples into float lines */
+extern ALvoid (*_alMixLoad16)(ALfloat **dst, ALuint channels,
+			      const ALshort *src, ALuint n);
+
+/* The same for unsigned 8 bit samples, widened to the 16 bit scale */
+extern ALvoid (*_alMixLoad8)(ALfloat **dst, ALuint channels,
+			     const ALubyte *src, ALuint n);
+
+/* The same for floats, scaled from -1.0 to 1.0 to the 16 bit scale */
+extern ALvoid (*_alMixLoadFloat)(ALfloat **dst, ALuint channels,
+				 const ALfloat *src, ALuint n);
+
+/* Buffer upload conversions over n samples: unsigned 8 bit to signed
+   16 bit, back again keeping the high byte, and swapping byte order */
+extern ALvoid (*_alConvertWiden8)(ALshort *dst, const ALubyte *src, ALuint n);
+extern ALvoid (*_alConvertNarrow16)(ALubyte *dst, const ALshort *src,
+				    ALuint n);
+extern ALvoid (*_alConvertSwap16)(ALshort *dst, const ALshort *src, ALuint n);
+
+ALvoid _alMixerInit(ALvoid);
+const char *_alMixerName(ALvoid);
+
+#endif
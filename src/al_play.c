@@ -18,6 +18,7 @@
  */
 
 #include <sys/time.h>
+#include <time.h>
 #include <math.h>
 #include <alloca.h>
 #include <string.h>
@@ -27,32 +28,41 @@
 #include "al_vector.h"
 #include "alc_device.h"
 #include "alc_context.h"
+#include "al_mixer.h"
+#include "al_command.h"
 
 
+/* The speaker each channel of a multichannel buffer is meant for, in
+   the order of the speakers file */
+static const ALubyte _al_quad_speakers[4] = { 0, 1, 2, 3 };
+static const ALubyte _al_surround_speakers[8] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+
 static ALfloat _alCalculateGainAndPitch(AL_source *src)
 {
 	AL_context *ctx = src->context;
 	ALCdevice *dev = ctx->device;
+	AL_source_params *par = &src->mix_param;
+	AL_listener *listener = &ctx->mix_listener;
 	ALfloat position[3];
-	ALfloat gain = ctx->listener.gain;	
+	ALfloat gain = listener->gain;	
 	
 
-	position[0] = src->position[0];
-	position[1] = src->position[1];
-	position[2] = src->position[2];
+	position[0] = par->position[0];
+	position[1] = par->position[1];
+	position[2] = par->position[2];
 
-	if (!src->relative)
+	if (!par->relative)
 	{
-		position[0] -= ctx->listener.position[0];
-		position[1] -= ctx->listener.position[1];
-		position[2] -= ctx->listener.position[2];
+		position[0] -= listener->position[0];
+		position[1] -= listener->position[1];
+		position[2] -= listener->position[2];
 	}
 
 	/* Master Gain */
 	{
 		ALfloat dist = _alVectorMagnitude(position);
 
-		gain *= ctx->distance_func(src, dist);
+		gain *= ctx->mix_distance_func(src, dist);
 
 		if (dist)
 		{
@@ -61,48 +71,50 @@ static ALfloat _alCalculateGainAndPitch(AL_source *src)
 			position[2] /= dist;
 		}
 
-		if (src->conic)
+		if (par->conic)
 		{
 			ALfloat a;
 
-			a = _alVectorDotProduct(position, src->direction);
+			a = _alVectorDotProduct(position, par->direction);
 
 			a = acos(-a) * 360.0 / M_PI;
 
-			if (a > src->cone_inner_angle)
+			if (a > par->cone_inner_angle)
 			{
-				if (a >= src->cone_outer_angle)
+				if (a >= par->cone_outer_angle)
 				{
-					gain *= src->cone_outer_gain;
+					gain *= par->cone_outer_gain;
 				}
 				else
 				{
-					a -= src->cone_inner_angle;
-					a *= (src->cone_outer_gain - 1.0f);
-					a /= (src->cone_outer_angle -
-					      src->cone_inner_angle);
+					a -= par->cone_inner_angle;
+					a *= (par->cone_outer_gain - 1.0f);
+					a /= (par->cone_outer_angle -
+					      par->cone_inner_angle);
 					gain *= (1.0f + a);
 				}
 			}
 		}
 
-		if (gain > src->max_gain)
+		if (gain > par->max_gain)
 		{
-			gain = src->max_gain;
+			gain = par->max_gain;
 		}
-		else if (gain < src->min_gain)
+		else if (gain < par->min_gain)
 		{
-			gain = src->min_gain;
+			gain = par->min_gain;
 		}		
 	}
 
+	src->gain = gain;
+
 	/* Speaker Gains */
 	{
 		ALuint i;
 
 		for (i = 0; i < src->channels; i++)
 		{
-			AL_speaker *speaker = &ctx->listener.speakers[i];
+			AL_speaker *speaker = &listener->speakers[i];
 
 			src->volume[i] = ( gain * ((_alVectorDotProduct(position, 
 						 			speaker->position) + 1.0f)
@@ -113,19 +125,19 @@ static ALfloat _alCalculateGainAndPitch(AL_source *src)
 	/* Pitch */
 	{
 		ALfloat vl, vs;
-		ALfloat pitch = src->pitch;
+		ALfloat pitch = par->pitch;
 
-		if (ctx->doppler_factor)
+		if (ctx->mix_doppler_factor)
 		{
-			vl = _alVectorDotProduct(ctx->listener.velocity,
+			vl = _alVectorDotProduct(listener->velocity,
 						 position);
-			vs = _alVectorDotProduct(src->velocity, position);
+			vs = _alVectorDotProduct(par->velocity, position);
 
-			vl *= ctx->doppler_factor;
-			vs *= ctx->doppler_factor;
+			vl *= ctx->mix_doppler_factor;
+			vs *= ctx->mix_doppler_factor;
 
-			vl += ctx->doppler_velocity;
-			vs += ctx->doppler_velocity;
+			vl += ctx->mix_doppler_velocity;
+			vs += ctx->mix_doppler_velocity;
 
 			pitch *= vl / vs;
 		}
@@ -139,132 +151,595 @@ static ALfloat _alCalculateGainAndPitch(AL_source *src)
 	}
 }
 
-snd_pcm_uframes_t _alWriteData(AL_source *src, ALfloat pitch,
-				      const snd_pcm_channel_area_t *area, snd_pcm_uframes_t frames,
-				      snd_pcm_uframes_t offset)
+/* What a callback is asked for, 16 bit with the buffer's channels */
+static const ALenum _al_stream_formats[_AL_MAX_LOAD + 1] =
 {
-	AL_queue *que;
-	AL_buffer *buf;
-	ALfloat inc, acc;
-	ALuint 	i;
-	ALfloat  j;
-	ALfloat vol[8];
-	int32_t *dest[8];
-	int c;
+	0, AL_FORMAT_MONO16, AL_FORMAT_STEREO16, 0, AL_FORMAT_QUAD16,
+	0, AL_FORMAT_51CHN16, 0, AL_FORMAT_71CHN16
+};
+
+/* Pull count frames from first on out of a callback buffer, in one
+   call, and move the lines on past them.  Frames the interpolators
+   read again come from the history, frames before the stream and
+   after it ran out are silence. */
+static ALvoid _alFetchStream(AL_source *src, AL_buffer *buf, ALfloat **dst,
+			     int64_t first, ALuint count)
+{
+	AL_context *ctx = src->context;
+	AL_decoder *dec = &src->decoder;
+	ALuint channels = buf->channels;
+	ALint got = 0;
+	ALuint i, c, n;
+
+	/* Starting over, or another stream */
+	if (dec->buffer != buf || dec->stamp != buf->stamp ||
+	    first < dec->frame - _AL_DECODE_HISTORY)
+	{
+		dec->buffer = buf;
+		dec->stamp = buf->stamp;
+		dec->start = 0;
+		dec->frame = 0;
+		dec->end = INT64_MAX;
+	}
 
+	for (i = 0; i < count && first + i < dec->frame; i++)
+	{
+		for (c = 0; c < channels; c++)
+		{
+			dst[c][i] = first + i < 0 ? 0.0f :
+				dec->history[(first + i) & _AL_DECODE_MASK][c];
+		}
+	}
 
-	if (!src->playing)
+	for (c = 0; c < channels; c++)
 	{
-		return 0;
+		dst[c] += i;
 	}
 
-	if ((que = src->current_q) ||
-	    ((que = src->first_q) && (que->state == AL_PENDING)))
+	if (i == count)
 	{
-		buf = que->buffer;
+		return;
 	}
-	else if ((buf = src->buffer))
+
+	/* Frames the cursor jumped over are never asked for */
+	if (first + i > dec->frame)
 	{
-		que = 0;
+		dec->frame = first + i;
 	}
-	else
+
+	n = count - i;
+
+	if (dec->frame < dec->end)
 	{
-		src->playing = AL_FALSE;
-		return 0;
+		got = buf->callback(src->id, buf->id,
+				    ctx->pull, _al_stream_formats[channels],
+				    buf->freq, n * channels) / (ALint)channels;
+
+		if (got < 0)
+		{
+			got = 0;
+		}
+		else if (got > (ALint)n)
+		{
+			got = n;
+		}
+
+		if (got < (ALint)n)
+		{
+			dec->end = dec->frame + got;
+		}
 	}
 
-	inc = pitch * (ALfloat)buf->freq / (ALfloat)src->freq ;
-			
-	for (c=0;c<src->channels;c++){
-		vol[c] = src->volume[c];
-		if (c % 2 != 0) vol[c] *= 65536.0f;		// Right channels
-		else 
-			dest[c] = area[c].addr + ((area[c].first + area[c].step * offset) >> 3);
+	_alMixLoad16(dst, channels, ctx->pull, got);
+
+	for (c = 0; c < channels; c++)
+	{
+		memset(dst[c] + got, 0, (n - got) * sizeof(ALfloat));
+		dst[c] += n;
 	}
-	
-	acc = 0;
-	i = 0;
-	
-	j = src->index;
-	if (buf->mono)	
+
+	for (i = got > _AL_DECODE_HISTORY ? got - _AL_DECODE_HISTORY : 0;
+	     i < (ALuint)got; i++)
+	{
+		for (c = 0; c < channels; c++)
+		{
+			dec->history[(dec->frame + i) & _AL_DECODE_MASK][c] =
+				ctx->pull[i * channels + c];
+		}
+	}
+
+	dec->frame += got;
+}
+
+/* Fetch count frames starting at first, which may lie outside the
+   buffer, into the stage lines and move them on.  Frames outside are
+   silence unless the buffer wraps around. */
+static ALvoid _alFetchFrames(AL_source *src, AL_buffer *buf, ALfloat **stage,
+			     ALboolean wrap, int64_t first, ALuint count)
+{
+	ALuint channels = buf->channels;
+	int64_t size = buf->stream ? INT64_MAX : buf->size;
+	ALuint c, n;
+
+	if (buf->encoding == _AL_ENCODING_CALLBACK)
 	{
-		ALfloat left;
+		_alFetchStream(src, buf, stage, first, count);
+		return;
+	}
 
-		while (i < frames)
+	while (count)
+	{
+		if (first >= 0 && first < size)
 		{
-			if ((ALuint)j >= buf->size)				
+			int64_t at = first;
+
+			n = count;
+
+			if (n > size - first)
 			{
-				j = 0;
-	
-				if (que)
-				{
-					que->state = AL_PROCESSED;
-					src->current_q = que->next;
-				}
-				else if(!src->looping)
+				n = size - first;
+			}
+
+			/* A ring wraps round at its end */
+			if (buf->stream)
+			{
+				at = first & (buf->size - 1);
+
+				if (n > buf->size - at)
 				{
-					src->playing = AL_FALSE;
+					n = buf->size - at;
 				}
-	
+			}
+
+			switch (buf->encoding)
+			{
+			case _AL_ENCODING_PCM8:
+				_alMixLoad8(stage, channels,
+					    (const ALubyte *)buf->data +
+					    at * channels, n);
+				break;
+			case _AL_ENCODING_FLOAT32:
+				_alMixLoadFloat(stage, channels,
+						(const ALfloat *)buf->data +
+						at * channels, n);
+				break;
+			case _AL_ENCODING_IMA4:
+				_alDecodeIMA(&src->decoder, buf, stage,
+					     first, n);
+				break;
+			default:
+				_alMixLoad16(stage, channels,
+					     buf->data + at * channels, n);
 				break;
 			}
+		}
+		else if (wrap && size)
+		{
+			if ((first %= size) < 0)
+			{
+				first += size;
+			}
+
+			continue;
+		}
+		else
+		{
+			n = count;
+
+			if (first < 0 && n > -first)
+			{
+				n = -first;
+			}
 
-			left = buf->data[(ALuint)j];
-			for (c=0;c<src->channels ;c+=2){
-				dest[c][i] = ((((ALint)(left *  vol[c])   & 0x0000FFFF)) | 
-						       ((ALint)(left *  vol[c+1]) & 0xFFFF0000));		
+			for (c = 0; c < channels; c++)
+			{
+				memset(stage[c], 0, n * sizeof(ALfloat));
 			}
-			i++;
-			j += inc;		
 		}
+
+		for (c = 0; c < channels; c++)
+		{
+			stage[c] += n;
+		}
+
+		first += n;
+		count -= n;
 	}
-	else
+}
+
+/* The entry after the one at q, if a voice can read straight on from
+   buf into it.  Callbacks are only ever asked for what is played. */
+static AL_buffer *_alNextQueued(AL_source *src, AL_buffer *buf, ALuint q)
+{
+	AL_buffer *next;
+
+	if (q + 1 == src->last_mix_q ||
+	    buf->encoding == _AL_ENCODING_CALLBACK)
+	{
+		return 0;
+	}
+
+	next = src->mix_queue[(q + 1) & src->mix_queue_mask];
+
+	if (next->channels != buf->channels ||
+	    next->encoding == _AL_ENCODING_CALLBACK)
+	{
+		return 0;
+	}
+
+	return next;
+}
+
+/* Fetch count frames starting at first into the stage lines.  A
+   queue plays as one sound: frames before a queued buffer are the
+   last ones of the entry before it and frames after it come from the
+   entries after, so the interpolators read across the seams. */
+static ALvoid _alFetchData(AL_source *src, AL_buffer *buf, ALboolean queued,
+			   ALboolean wrap, int64_t first, ALuint count)
+{
+	AL_context *ctx = src->context;
+	ALfloat *stage[_AL_MAX_LOAD];
+	ALuint channels = buf->channels;
+	ALuint q = src->current_q;
+	AL_buffer *next;
+	ALuint c, i, n;
+
+	for (c = 0; c < channels; c++)
 	{
-		ALfloat left,right;
-		__int32_t *p=(__int32_t*)buf->data;
-		
+		stage[c] = ctx->stage[c];
+	}
 
-		while (i < frames)
+	if (!queued)
+	{
+		_alFetchFrames(src, buf, stage, wrap, first, count);
+		return;
+	}
+
+	if (first < 0 && src->seam_q == q && src->seam_channels == channels)
+	{
+		n = count < -first ? count : (ALuint)-first;
+
+		for (c = 0; c < channels; c++)
 		{
-			if ((ALuint)j >= buf->size)				
+			for (i = 0; i < n; i++)
 			{
-				j = 0;
-	
-				if (que)
-				{
-					que->state = AL_PROCESSED;
-					src->current_q = que->next;
-				}
-				else if(!src->looping)
+				stage[c][i] =
+					src->seam[c][_AL_RESAMPLE_PRE + first + i];
+			}
+
+			stage[c] += n;
+		}
+
+		first += n;
+		count -= n;
+	}
+
+	for (;;)
+	{
+		if (first < (int64_t)buf->size)
+		{
+			n = count;
+
+			if (n > buf->size - first)
+			{
+				n = buf->size - first;
+			}
+
+			_alFetchFrames(src, buf, stage, AL_FALSE, first, n);
+
+			first += n;
+			count -= n;
+
+			/* Keep the end for when the next entry starts */
+			if (first == buf->size &&
+			    buf->encoding != _AL_ENCODING_CALLBACK)
+			{
+				for (c = 0; c < channels; c++)
 				{
-					src->playing = AL_FALSE;
+					for (i = 0; i < _AL_RESAMPLE_PRE; i++)
+					{
+						src->seam[c][i] = stage[c]
+							[(ALint)i - _AL_RESAMPLE_PRE];
+					}
 				}
-	
-				break;
+
+				src->seam_q = q + 1;
+				src->seam_channels = channels;
+			}
+		}
+
+		if (!count)
+		{
+			return;
+		}
+
+		if (!(next = _alNextQueued(src, buf, q)))
+		{
+			_alFetchFrames(src, buf, stage, AL_FALSE, first, count);
+			return;
+		}
+
+		first -= buf->size;
+		buf = next;
+		q++;
+	}
+}
+
+static snd_pcm_uframes_t _alMixData(AL_source *src, ALfloat pitch,
+				    snd_pcm_uframes_t offset,
+				    snd_pcm_uframes_t frames)
+{
+	AL_context *ctx = src->context;
+	ALboolean queued;
+	AL_buffer *buf, *next;
+	ALfloat *bus[_ALC_NUM_SPEAKERS];
+	uint64_t pos, end, step, left;
+	ALuint channels, frac, span, count;
+	ALfloat ratio;
+	ALuint c, n;
+
+	if (!src->playing)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		if ((queued = src->current_q != src->last_mix_q))
+		{
+			buf = src->mix_queue[src->current_q &
+					     src->mix_queue_mask];
+		}
+		else if (!(buf = src->mix_buffer))
+		{
+			src->playing = AL_FALSE;
+			return 0;
+		}
+		/* The API may be replacing the samples of a buffer it has
+		   already taken off the source, that cycle plays silence */
+		else if (_alSnapBuffer(buf, &src->mix_copy))
+		{
+			buf = &src->mix_copy;
+		}
+		else
+		{
+			return frames;
+		}
+
+		end = (uint64_t)buf->size << _AL_FRAC_BITS;
+		pos = src->cursor;
+
+		/* A ring plays what has been appended, short of the frames
+		   the interpolators read ahead.  Starting over carries on
+		   from where it was, running dry plays silence until more
+		   is appended. */
+		if (buf->stream)
+		{
+			uint64_t write = __atomic_load_n(&buf->stream->write,
+							 __ATOMIC_ACQUIRE);
+			uint64_t read = buf->stream->read << _AL_FRAC_BITS;
+
+			/* Copied before the first append set the ring up */
+			if (!buf->data)
+			{
+				return frames;
 			}
 
+			if (pos < read)
+			{
+				pos = src->cursor = read;
+			}
+
+			end = write > _AL_RESAMPLE_POST ?
+				(write - _AL_RESAMPLE_POST) << _AL_FRAC_BITS : 0;
+
+			if (pos >= end)
+			{
+				return frames;
+			}
+		}
+
+		/* A stream ends where its callback came up short */
+		if (buf->encoding == _AL_ENCODING_CALLBACK &&
+		    src->decoder.buffer == buf &&
+		    src->decoder.stamp == buf->stamp &&
+		    src->decoder.end < buf->size)
+		{
+			end = (uint64_t)src->decoder.end << _AL_FRAC_BITS;
+		}
+
+		if (pos < end || !queued)
+		{
+			break;
+		}
+
+		/* On into the next entry with the phase the last one left
+		   off at.  The API may unqueue it once it is processed. */
+		src->cursor = pos - end;
+		__atomic_store_n(&src->current_q, src->current_q + 1,
+				 __ATOMIC_RELEASE);
+	}
+
+	channels = buf->channels;
+
+	if (pos >= end)
+	{
+		if (src->mix_param.looping && end &&
+		    buf->encoding != _AL_ENCODING_CALLBACK)
+		{
+			src->cursor = pos % end;
+		}
+		else
+		{
+			src->playing = AL_FALSE;
+		}
+
+		return 0;
+	}
+
+	ratio = pitch * (ALfloat)buf->freq / (ALfloat)src->freq;
+
+	if (ratio > 255.0f)
+	{
+		ratio = 255.0f;
+	}
+
+	step = (uint64_t)(ratio * (ALfloat)_AL_FRAC_ONE);
+	frac = (ALuint)(pos & _AL_FRAC_MASK);
+
+	/* Stop at the end of the buffer, or of the next entry when the
+	   voice runs straight on into it, and at the end of the stage */
+	n = frames;
+
+	if (queued && (next = _alNextQueued(src, buf, src->current_q)) &&
+	    next->freq == buf->freq)
+	{
+		end += (uint64_t)next->size << _AL_FRAC_BITS;
+	}
+
+	if (step)
+	{
+		left = (end - pos + step - 1) / step;
+
+		if (n > left)
+		{
+			n = left;
+		}
+
+		span = ctx->stage_size - _AL_RESAMPLE_PRE - _AL_RESAMPLE_POST;
+		left = (((uint64_t)span << _AL_FRAC_BITS) - 1 - frac) / step + 1;
+
+		if (n > left)
+		{
+			n = left;
+		}
+	}
+
+	count = (ALuint)((frac + (n - 1) * step) >> _AL_FRAC_BITS) + 1 +
+		_AL_RESAMPLE_PRE + _AL_RESAMPLE_POST;
+
+	/* Fetch the samples and resample them into the voice lines */
+	_alFetchData(src, buf, queued, src->mix_param.looping,
+		     (int64_t)(pos >> _AL_FRAC_BITS) - _AL_RESAMPLE_PRE, count);
+
+	for (c = 0; c < channels; c++)
+	{
+		_alResample[ctx->device->resampler](ctx->voice[c],
+						    ctx->stage[c] +
+						    _AL_RESAMPLE_PRE,
+						    frac, step, n);
+	}
+
+	src->cursor = pos + n * step;
+
+	if (buf->stream)
+	{
+		__atomic_store_n(&buf->stream->read,
+				 src->cursor >> _AL_FRAC_BITS, __ATOMIC_RELEASE);
+	}
+
+	/* Spread them over the bus */
+	for (c = 0; c < (ALuint)src->channels; c++)
+	{
+		bus[c] = ctx->bus[c] + offset;
+	}
+
+	if (channels == 1)
+	{
+		_alMixPan(bus, src->channels, ctx->voice[0], src->volume, n);
+	}
+	else if (channels == 2)
+	{
+		/* Left goes to the even speakers, right to the odd */
+		for (c = 0; c < (ALuint)src->channels; c++)
+		{
+			_alMixGain(bus[c], ctx->voice[c & 1], src->volume[c], n);
+		}
+	}
+	else
+	{
+		/* Each channel goes straight to its own speaker, or to the
+		   ones standing in for it */
+		const ALubyte *roles = channels == 4 ?
+			_al_quad_speakers : _al_surround_speakers;
+		ALuint s;
+
+		for (c = 0; c < channels; c++)
+		{
+			const ALfloat *route = ctx->route[roles[c]];
 
-			left   = (ALshort)(p[(ALuint)j] & 0x0000FFFF);			
-			right  = (ALshort)((p[(ALuint)j] & 0xFFFF0000)>>16);
-			
-			for (c=0;c<src->channels ;c+=2){
-				dest[c][i] = ((((ALint)(left  *  vol[c])   & 0x0000FFFF)) | 
-						       ((ALint)(right *  vol[c+1]) & 0xFFFF0000));		
+			for (s = 0; s < (ALuint)src->channels; s++)
+			{
+				if (route[s] > 0.0f)
+				{
+					_alMixGain(bus[s], ctx->voice[c],
+						   src->gain * route[s], n);
+				}
 			}
-		    i++;		          	     
-			j += inc;		
 		}
+	}
+
+	return n;
+}
+
+static snd_pcm_uframes_t _alMixSource(AL_source *src, ALfloat pitch,
+				      snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t written = 0;
+	snd_pcm_uframes_t f;
 
+	while (written < frames && src->playing)
+	{
+		f = _alMixData(src, pitch, written, frames - written);
+		written += f;
 	}
 
-	src->index = j;	 	
+	return written;
+}
+
+static ALvoid _alClearMix(AL_context *ctx, ALuint channels,
+			  snd_pcm_uframes_t frames)
+{
+	ALuint c;
+
+	for (c = 0; c < channels; c++)
+	{
+		memset(ctx->bus[c], 0, frames * sizeof(ALfloat));
+	}
+}
+
+static ALvoid _alWriteMix(AL_context *ctx, const snd_pcm_channel_area_t *area,
+			  snd_pcm_uframes_t offset, snd_pcm_uframes_t frames,
+			  ALuint channels)
+{
+	ALuint c;
+
+	for (c = 0; c < channels; c++)
+	{
+		ALshort *dest = (ALshort *)((char *)area[c].addr +
+			((area[c].first + area[c].step * offset) >> 3));
 
-	return i;
+		_alMixOutput(dest, area[c].step >> 4, ctx->bus[c], frames);
+	}
 }
 
+/* The mixer ran out of data, unless the API has sent another
+   transport command in the meantime the source is now stopped. */
+static ALvoid _alSourceFinished(AL_source *src)
+{
+	uint64_t status = _alSourceStatus(src->serial, AL_PLAYING);
+
+	src->state = AL_STOPPED;
+
+	__atomic_compare_exchange_n(&src->status, &status,
+				    _alSourceStatus(src->serial, AL_STOPPED),
+				    0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
 
 ALvoid _alProcessSource(AL_source *src)
 {
+	AL_context *ctx = src->context;
+	ALCdevice *dev = ctx->device;
 	const snd_pcm_channel_area_t *area;
  	snd_pcm_sframes_t avail;
 	ALfloat pitch;
@@ -282,27 +757,44 @@ ALvoid _alProcessSource(AL_source *src)
 
 	if (state != SND_PCM_STATE_RUNNING)
 	{
+		if (state == SND_PCM_STATE_XRUN)
+		{
+			_alcDeviceXrun(dev);
+		}
+
 		if (src->playing)
 		{
 			snd_pcm_prepare(src->handle);
 		}
 		else
 		{
-			src->state = AL_STOPPED;
+			_alSourceFinished(src);
 			return;
 		}
 	}
 
 	pitch = _alCalculateGainAndPitch(src);
 
-	avail = snd_pcm_avail_update(src->handle);
+	if ((avail = snd_pcm_avail_update(src->handle)) < 0)
+	{
+		_alcDeviceXrun(dev);
+		snd_pcm_prepare(src->handle);
+		avail = snd_pcm_avail_update(src->handle);
+	}
+
+	avail -= _alcHeadroom(dev, src->handle, src->buffer_size,
+			      src->period_size, &src->wakeup);
 
 	while (avail > 0)
 	{
 		snd_pcm_uframes_t offset;
 		snd_pcm_uframes_t frames = avail;
-		snd_pcm_uframes_t written = 0;
-		int32_t *map,*map1;
+		snd_pcm_uframes_t written;
+
+		if (frames > dev->buffer_size)
+		{
+			frames = dev->buffer_size;
+		}
 
 		if (snd_pcm_mmap_begin(src->handle, &area, &offset, &frames))
 		{
@@ -311,23 +803,15 @@ ALvoid _alProcessSource(AL_source *src)
 
 		avail -= frames;
 
-		while (frames)
-		{
-			snd_pcm_uframes_t f;
+		_alClearMix(ctx, src->channels, frames);
 
-			if (!(f = _alWriteData(src, pitch, area, frames, offset)))
-			{
-/*				bzero(area, frames << 2);*/
-				avail = 0;
-				break;
-			}
-
-			map  += f;
-			map1 += f;			
-			written += f;
-			frames -= f;
+		if ((written = _alMixSource(src, pitch, frames)) < frames)
+		{
+			avail = 0;
 		}
 
+		_alWriteMix(ctx, area, offset, written, src->channels);
+
 		snd_pcm_mmap_commit(src->handle, offset, written);
 	}
 
@@ -348,54 +832,299 @@ ALvoid _alProcessSource(AL_source *src)
 	}
 }
 
-static ALvoid _alSourcePlay(AL_source *src)
-{	
-	switch(src->state)
+/* Sum every playing source into frames of the bus and write them out */
+static ALvoid _alMixSources(AL_context *ctx, const snd_pcm_channel_area_t *area,
+			   snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+	ALCdevice *dev = ctx->device;
+	ALuint mixed = 0, skipped = 0;
+	ALuint i;
+
+	_alClearMix(ctx, dev->channels, frames);
+
+	for (i = 0; i < ctx->mix_source_slots; i++)
 	{
-	case AL_PAUSED:
-		snd_pcm_pause(src->handle, 0);
-		break;
-	case AL_PLAYING:
-		src->index = 0;
-		break;
+		AL_source *src;
+
+		if (!(src = ctx->mix_sources[i]))
+		{
+			continue;
+		}
+
+		if (src->state != AL_PLAYING)
+		{
+			skipped++;
+			continue;
+		}
+
+		_alMixSource(src, _alCalculateGainAndPitch(src), frames);
+
+		if (!src->playing)
+		{
+			_alSourceFinished(src);
+		}
+
+		mixed++;
 	}
-	src->state = AL_PLAYING;
-	src->playing = AL_TRUE;
+
+	_alWriteMix(ctx, area, offset, frames, dev->channels);
+
+	_alcDeviceVoices(dev, mixed, skipped);
 }
 
-ALvoid _alSourceStop(AL_source *src)
+/* Software mixer: sum every playing source into the device pcm */
+static ALvoid _alMixContext(AL_context *ctx)
 {
-	switch (src->state)
+	ALCdevice *dev = ctx->device;
+	const snd_pcm_channel_area_t *area;
+	snd_pcm_sframes_t avail;
+	int state;
+
+	state = snd_pcm_state(dev->handle);
+
+	if (state != SND_PCM_STATE_RUNNING)
 	{
-	case AL_PAUSED:
-		snd_pcm_pause(src->handle, 0);
-	case AL_PLAYING:
-		snd_pcm_drop(src->handle);
+		if (state == SND_PCM_STATE_XRUN)
+		{
+			_alcDeviceXrun(dev);
+		}
+
+		snd_pcm_prepare(dev->handle);
+	}
+
+	if ((avail = snd_pcm_avail_update(dev->handle)) < 0)
+	{
+		_alcDeviceXrun(dev);
+		snd_pcm_prepare(dev->handle);
+		avail = snd_pcm_avail_update(dev->handle);
+	}
+
+	avail -= _alcHeadroom(dev, dev->handle, dev->buffer_size,
+			      dev->period_size, &dev->wakeup);
+
+	while (avail > 0)
+	{
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames = avail;
+
+		if (frames > dev->buffer_size)
+		{
+			frames = dev->buffer_size;
+		}
+
+		if (snd_pcm_mmap_begin(dev->handle, &area, &offset, &frames))
+		{
+			return;
+		}
+
+		avail -= frames;
+
+		_alMixSources(ctx, area, offset, frames);
+
+		snd_pcm_mmap_commit(dev->handle, offset, frames);
+	}
+
+	if (state != SND_PCM_STATE_RUNNING)
+	{
+		snd_pcm_start(dev->handle);
 	}
-	src->state = AL_STOPPED;
-	src->index = 0;
 }
 
-static ALvoid _alSourcePause(AL_source *src)
+/* Loopback: mix straight into the caller's interleaved buffer */
+ALvoid _alRenderContext(AL_context *ctx, ALshort *data, ALuint frames)
 {
-	if (src->state == AL_PLAYING)
+	ALCdevice *dev = ctx->device;
+	snd_pcm_channel_area_t area[_ALC_NUM_SPEAKERS];
+	snd_pcm_uframes_t offset = 0;
+	snd_pcm_uframes_t n;
+	struct timespec start;
+	ALuint c;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	_alProcessCommands(ctx);
+
+	for (c = 0; c < dev->channels; c++)
+	{
+		area[c].addr = data;
+		area[c].first = c * 16;
+		area[c].step = dev->channels * 16;
+	}
+
+	while (frames)
 	{
-		snd_pcm_pause(src->handle, 1);
-		src->state = AL_PAUSED;
+		n = frames;
+
+		if (n > dev->buffer_size)
+		{
+			n = dev->buffer_size;
+		}
+
+		_alMixSources(ctx, area, offset, n);
+
+		offset += n;
+		frames -= n;
 	}
+
+	_alcDeviceCycle(dev, &start);
 }
 
-static ALvoid _alSourceRewind(AL_source *src)
+ALvoid _alProcessContext(AL_context *ctx)
 {
-	switch (src->state)
+	ALCdevice *dev = ctx->device;
+	ALuint mixed = 0, skipped = 0;
+	struct timespec start;
+	ALuint i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	_alProcessCommands(ctx);
+
+	/* A loopback device only mixes when it is rendered */
+	if (dev->loopback)
+	{
+		return;
+	}
+
+	_alcDeviceSettle(dev);
+
+	if (dev->mixer)
+	{
+		_alMixContext(ctx);
+	}
+	else
+	{
+		for (i = 0; i < ctx->mix_source_slots; i++)
+		{
+			AL_source *src;
+
+			if (!(src = ctx->mix_sources[i]))
+			{
+				continue;
+			}
+
+			if (src->state == AL_PLAYING)
+			{
+				mixed++;
+			}
+			else
+			{
+				skipped++;
+			}
+
+			_alProcessSource(src);
+		}
+
+		_alcDeviceVoices(dev, mixed, skipped);
+	}
+
+	_alcDeviceCycle(dev, &start);
+}
+
+/* Mixer side of the transport commands */
+ALvoid _alSourceTransport(AL_source *src, ALenum state, ALuint serial)
+{
+	uint64_t status;
+
+	switch (state)
 	{
-	case AL_PAUSED:
-		snd_pcm_pause(src->handle, 0);
 	case AL_PLAYING:
-		snd_pcm_drop(src->handle);
+		if (src->state == AL_PAUSED)
+		{
+			if (src->handle) snd_pcm_pause(src->handle, 0);
+		}
+		else
+		{
+			src->cursor = 0;
+			src->decoder.buffer = 0;
+			src->seam_channels = 0;
+		}
+		src->state = AL_PLAYING;
+		src->playing = AL_TRUE;
+		break;
+	case AL_PAUSED:
+		if (src->state == AL_PLAYING)
+		{
+			if (src->handle) snd_pcm_pause(src->handle, 1);
+			src->state = AL_PAUSED;
+		}
+		break;
+	default:
+		switch (src->state)
+		{
+		case AL_PAUSED:
+			if (src->handle) snd_pcm_pause(src->handle, 0);
+		case AL_PLAYING:
+			if (src->handle) snd_pcm_drop(src->handle);
+		}
+		src->state = state;
+		src->cursor = 0;
+		break;
+	}
+
+	src->serial = serial;
+
+	/* Pausing a source that ran out in the meantime leaves it stopped */
+	if (src->state != state)
+	{
+		status = _alSourceStatus(serial, state);
+
+		__atomic_compare_exchange_n(&src->status, &status,
+					    _alSourceStatus(serial, src->state),
+					    0, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED);
+	}
+}
+
+/* Mixer side of alSourceQueueBuffers, the entries up to last are filled */
+ALvoid _alSourceQueue(AL_source *src, ALuint last)
+{
+	src->last_mix_q = last;
+}
+
+/* API side, the state changes at once and the mixer follows */
+static ALvoid _alSourceCommand(AL_source *src, ALenum state)
+{
+	AL_context *ctx = src->context;
+	AL_command cmd;
+	uint64_t status;
+	ALuint serial;
+
+	/* Without the software mixer a source needs a pcm to play on */
+	if (state == AL_PLAYING && !_alcOpenVoice(src))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return;
+	}
+
+	status = __atomic_load_n(&src->status, __ATOMIC_ACQUIRE);
+
+	do
+	{
+		if (state == AL_PAUSED && (ALenum)(ALuint)status != AL_PLAYING)
+		{
+			return;
+		}
+
+		serial = (ALuint)(status >> 32) + 1;
+	}
+	while (!__atomic_compare_exchange_n(&src->status, &status,
+					    _alSourceStatus(serial, state),
+					    0, __ATOMIC_ACQ_REL,
+					    __ATOMIC_ACQUIRE));
+
+	cmd.type = _AL_CMD_SOURCE_TRANSPORT;
+	cmd.source = src;
+	cmd.u.transport.state = state;
+	cmd.u.transport.serial = serial;
+
+	_alSendCommand(ctx, &cmd);
+
+	/* The mixer thread only polls the pcms of playing sources */
+	if (state == AL_PLAYING && src->voice)
+	{
+		_alcWakeContext(ctx);
 	}
-	src->state = AL_INITIAL;
-	src->index = 0;
 }
 
 ALvoid alSourcePlay(ALuint sid)
@@ -418,7 +1147,7 @@ ALvoid alSourcePlay(ALuint sid)
 	}
 	else
 	{
-		_alSourcePlay(src);
+		_alSourceCommand(src, AL_PLAYING);
 	}
 
 	_alcUnlockContext(ctx);
@@ -443,7 +1172,7 @@ ALvoid alSourceStop(ALuint sid)
 	}
 	else
 	{
-		_alSourceStop(src);
+		_alSourceCommand(src, AL_STOPPED);
 	}
 
 	_alcUnlockContext(ctx);
@@ -468,7 +1197,7 @@ ALvoid alSourcePause(ALuint sid)
 	}
 	else
 	{
-		_alSourcePause(src);
+		_alSourceCommand(src, AL_PAUSED);
 	}
 
 	_alcUnlockContext(ctx);
@@ -493,7 +1222,7 @@ ALvoid alSourceRewind(ALuint sid)
 	}
 	else
 	{
-		_alSourceRewind(src);
+		_alSourceCommand(src, AL_INITIAL);
 	}
 
 	_alcUnlockContext(ctx);
@@ -526,7 +1255,7 @@ ALvoid alSourcePlayv(ALsizei ns, ALuint *ids)
 
 	for (i = 0; i < ns; i++)
 	{
-		_alSourcePlay(src[i]);
+		_alSourceCommand(src[i], AL_PLAYING);
 	}
 
 unlock:
@@ -560,7 +1289,7 @@ ALvoid alSourceStopv(ALsizei ns, ALuint *ids)
 	
 	for (i = 0; i < ns; i++)
 	{
-		_alSourceStop(src[i]);
+		_alSourceCommand(src[i], AL_STOPPED);
 	}
 
 unlock:
@@ -594,7 +1323,7 @@ ALvoid alSourcePausev(ALsizei ns, ALuint *ids)
 
 	for (i = 0; i < ns; i++)
 	{
-		_alSourcePause(src[i]);
+		_alSourceCommand(src[i], AL_PAUSED);
 	}
 
 unlock:
@@ -628,7 +1357,7 @@ ALvoid alSourceRewindv(ALsizei ns, ALuint *ids)
 
 	for (i = 0; i < ns; i++)
 	{
-		_alSourceRewind(src[i]);
+		_alSourceCommand(src[i], AL_INITIAL);
 	}
 
 unlock:
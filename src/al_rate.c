@@ -0,0 +1,462 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "al_rate.h"
+
+/* Kaiser window shape, about 90dB of stop band */
+#define _AL_RATE_BETA 9.0
+
+/* Pass band as a part of the lower rate's Nyquist frequency */
+#define _AL_RATE_CUTOFF 0.92
+
+typedef struct _AL_rate_filter
+{
+	ALuint up;		/* output frames per down input frames */
+	ALuint down;
+	ALuint phases;
+	ALuint taps;
+	ALfloat *table;		/* phases + 1 rows of taps */
+}
+AL_rate_filter;
+
+static pthread_once_t _al_rate_once = PTHREAD_ONCE_INIT;
+static ALboolean _al_rate_thread = AL_FALSE;
+
+/* Held to queue and unqueue conversions and to hand the samples over */
+static pthread_mutex_t _al_rate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _al_rate_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _al_rate_done = PTHREAD_COND_INITIALIZER;
+
+/* Conversions waiting */
+static AL_buffer *_al_rate_first = 0;
+static AL_buffer **_al_rate_last = &_al_rate_first;
+
+static double _alBesselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	int k;
+
+	for (k = 1; k < 32; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static ALuint _alRateGCD(ALuint a, ALuint b)
+{
+	while (b)
+	{
+		ALuint t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* Windowed sinc taps for every phase between two input frames.  Each
+   row sums to one so silence and steady levels pass unchanged. */
+static ALboolean _alRateFilter(AL_rate_filter *f, ALuint from, ALuint to)
+{
+	ALuint g = _alRateGCD(from, to);
+	ALuint half, p, t;
+	double fc, width, i0;
+
+	f->up = to / g;
+	f->down = from / g;
+	f->phases = f->up < _AL_RATE_PHASES ? f->up : _AL_RATE_PHASES;
+
+	/* Cutoff in cycles per input frame */
+	fc = 0.5 * _AL_RATE_CUTOFF * (to < from ? (double)to / from : 1.0);
+	width = _AL_RATE_ZEROS / (2.0 * fc);
+	half = (ALuint)ceil(width);
+	f->taps = 2 * half;
+
+	if (!(f->table = malloc((f->phases + 1) * f->taps * sizeof(ALfloat))))
+	{
+		return AL_FALSE;
+	}
+
+	i0 = _alBesselI0(_AL_RATE_BETA);
+
+	for (p = 0; p <= f->phases; p++)
+	{
+		ALfloat *row = f->table + p * f->taps;
+		double sum = 0.0;
+
+		for (t = 0; t < f->taps; t++)
+		{
+			/* Tap t reads the frame half - 1 - t before the
+			   output's position */
+			double d = (double)t - (half - 1) -
+				   (double)p / f->phases;
+			double h = 0.0;
+
+			if (fabs(d) < width)
+			{
+				double r = d / width;
+				double x = 2.0 * M_PI * fc * d;
+
+				h = 2.0 * fc * (x ? sin(x) / x : 1.0) *
+				    _alBesselI0(_AL_RATE_BETA *
+						sqrt(1.0 - r * r)) / i0;
+			}
+
+			row[t] = h;
+			sum += h;
+		}
+
+		for (t = 0; t < f->taps; t++)
+		{
+			row[t] /= sum;
+		}
+	}
+
+	return AL_TRUE;
+}
+
+static ALuint _alRateBytes(AL_buffer *buf)
+{
+	switch (buf->encoding)
+	{
+	case _AL_ENCODING_PCM8:
+		return 1;
+	case _AL_ENCODING_FLOAT32:
+		return 4;
+	default:
+		return 2;
+	}
+}
+
+/* The buffer's samples at rate in the same encoding, or 0 */
+static ALvoid *_alRateConvert(AL_buffer *buf, ALuint rate, ALuint *frames)
+{
+	AL_rate_filter f;
+	ALuint channels = buf->channels;
+	ALuint bytes = _alRateBytes(buf);
+	ALuint size = buf->size;
+	ALuint half, c, j, n;
+	uint64_t count;
+	ALfloat *line;
+	ALvoid *out;
+
+	if (!_alRateFilter(&f, buf->freq, rate))
+	{
+		return 0;
+	}
+
+	half = f.taps / 2;
+	count = ((uint64_t)size * f.up + f.down - 1) / f.down;
+
+	if (count * channels * bytes > 0x7FFFFFFF)
+	{
+		free(f.table);
+		return 0;
+	}
+
+	n = (ALuint)count;
+	out = malloc(n * channels * bytes);
+	line = malloc((size + f.taps) * sizeof(ALfloat));
+
+	if (!out || !line)
+	{
+		free(out);
+		free(line);
+		free(f.table);
+		return 0;
+	}
+
+	for (c = 0; c < channels; c++)
+	{
+		ALuint i, rem;
+
+		/* The channel as floats with silence either side */
+		memset(line, 0, half * sizeof(ALfloat));
+		memset(line + half + size, 0, half * sizeof(ALfloat));
+
+		for (i = 0; i < size; i++)
+		{
+			switch (buf->encoding)
+			{
+			case _AL_ENCODING_PCM8:
+				line[half + i] = (ALint)((ALubyte *)buf->data)
+					[i * channels + c] - 128;
+				break;
+			case _AL_ENCODING_FLOAT32:
+				line[half + i] = ((ALfloat *)buf->data)
+					[i * channels + c];
+				break;
+			default:
+				line[half + i] = buf->data[i * channels + c];
+				break;
+			}
+		}
+
+		/* Output frame j sits at i + rem / up input frames */
+		i = 0;
+		rem = 0;
+
+		for (j = 0; j < n; j++)
+		{
+			uint64_t q = (uint64_t)rem * f.phases;
+			ALuint p = (ALuint)(q / f.up);
+			ALfloat frac = (ALfloat)(q % f.up) / (ALfloat)f.up;
+			const ALfloat *a = f.table + p * f.taps;
+			const ALfloat *b = a + f.taps;
+			const ALfloat *in = line + i + 1;
+			ALfloat sum = 0.0f;
+			ALuint t;
+
+			if (frac == 0.0f)
+			{
+				for (t = 0; t < f.taps; t++)
+				{
+					sum += a[t] * in[t];
+				}
+			}
+			else
+			{
+				for (t = 0; t < f.taps; t++)
+				{
+					sum += (a[t] + frac * (b[t] - a[t])) *
+					       in[t];
+				}
+			}
+
+			switch (buf->encoding)
+			{
+			case _AL_ENCODING_PCM8:
+				sum = sum < -128.0f ? -128.0f :
+				      sum > 127.0f ? 127.0f : sum;
+				((ALubyte *)out)[j * channels + c] =
+					(ALubyte)(lrintf(sum) + 128);
+				break;
+			case _AL_ENCODING_FLOAT32:
+				((ALfloat *)out)[j * channels + c] = sum;
+				break;
+			default:
+				sum = sum < -32768.0f ? -32768.0f :
+				      sum > 32767.0f ? 32767.0f : sum;
+				((ALshort *)out)[j * channels + c] =
+					(ALshort)lrintf(sum);
+				break;
+			}
+
+			rem += f.down;
+			i += rem / f.up;
+			rem %= f.up;
+		}
+	}
+
+	free(line);
+	free(f.table);
+
+	*frames = n;
+
+	return out;
+}
+
+/* With the mutex held, or before anyone else can see the buffer */
+static ALvoid _alRatePublish(AL_buffer *buf, ALvoid *data, ALuint frames)
+{
+	if (data)
+	{
+		_alBeginWrite(buf);
+
+		/* Short of memory to keep the old samples for a mixer still
+		   reading them, it plays them resampled */
+		if (_alDropData(buf, buf->data, 0))
+		{
+			buf->data = data;
+			buf->size = frames;
+			buf->freq = buf->rate;
+		}
+		else
+		{
+			free(data);
+		}
+
+		_alEndWrite(buf);
+	}
+
+	__atomic_store_n(&buf->rate, 0, __ATOMIC_RELEASE);
+}
+
+static ALvoid _alRateUnlink(AL_buffer *buf)
+{
+	AL_buffer **link;
+
+	for (link = &_al_rate_first; *link; link = &(*link)->rate_next)
+	{
+		if (*link == buf)
+		{
+			if (!(*link = buf->rate_next))
+			{
+				_al_rate_last = link;
+			}
+
+			break;
+		}
+	}
+}
+
+/* With the mutex held, converts buf without it */
+static ALvoid _alRateRun(AL_buffer *buf)
+{
+	ALvoid *data;
+	ALuint frames;
+
+	_alRateUnlink(buf);
+	buf->rate_busy = AL_TRUE;
+
+	pthread_mutex_unlock(&_al_rate_mutex);
+
+	data = _alRateConvert(buf, buf->rate, &frames);
+
+	pthread_mutex_lock(&_al_rate_mutex);
+
+	buf->rate_busy = AL_FALSE;
+	_alRatePublish(buf, data, frames);
+
+	pthread_cond_broadcast(&_al_rate_done);
+}
+
+static ALvoid *_alRateThread(ALvoid *arg)
+{
+	AL_buffer *buf;
+
+	(void)arg;
+
+	pthread_mutex_lock(&_al_rate_mutex);
+
+	for (;;)
+	{
+		while (!(buf = _al_rate_first))
+		{
+			pthread_cond_wait(&_al_rate_work, &_al_rate_mutex);
+		}
+
+		_alRateRun(buf);
+	}
+
+	return 0;
+}
+
+static ALvoid _alRateStart(ALvoid)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	_al_rate_thread = !pthread_create(&thread, &attr, _alRateThread, 0);
+
+	pthread_attr_destroy(&attr);
+}
+
+/* Called with the buffer locked for writing, nobody plays it yet */
+ALvoid _alRateSchedule(AL_buffer *buf, ALuint rate)
+{
+	if (!rate || rate == buf->freq || !buf->size || buf->borrowed ||
+	    buf->encoding == _AL_ENCODING_IMA4)
+	{
+		return;
+	}
+
+	pthread_once(&_al_rate_once, _alRateStart);
+
+	buf->rate = rate;
+
+	/* Without a thread it's done now */
+	if (!_al_rate_thread)
+	{
+		ALuint frames;
+		ALvoid *data = _alRateConvert(buf, rate, &frames);
+
+		_alRatePublish(buf, data, frames);
+		return;
+	}
+
+	pthread_mutex_lock(&_al_rate_mutex);
+
+	buf->rate_next = 0;
+	*_al_rate_last = buf;
+	_al_rate_last = &buf->rate_next;
+
+	pthread_cond_signal(&_al_rate_work);
+	pthread_mutex_unlock(&_al_rate_mutex);
+}
+
+ALvoid _alRateCancel(AL_buffer *buf)
+{
+	if (!__atomic_load_n(&buf->rate, __ATOMIC_ACQUIRE))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&_al_rate_mutex);
+
+	while (buf->rate_busy)
+	{
+		pthread_cond_wait(&_al_rate_done, &_al_rate_mutex);
+	}
+
+	if (buf->rate)
+	{
+		_alRateUnlink(buf);
+		__atomic_store_n(&buf->rate, 0, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&_al_rate_mutex);
+}
+
+/* A conversion still waiting is done on the caller's thread rather
+   than have it wait for the ones queued before it */
+ALvoid _alRateFinish(AL_buffer *buf)
+{
+	if (!__atomic_load_n(&buf->rate, __ATOMIC_ACQUIRE))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&_al_rate_mutex);
+
+	while (buf->rate_busy)
+	{
+		pthread_cond_wait(&_al_rate_done, &_al_rate_mutex);
+	}
+
+	if (buf->rate)
+	{
+		_alRateRun(buf);
+	}
+
+	pthread_mutex_unlock(&_al_rate_mutex);
+}
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _AL_RATE_H_
+#define _AL_RATE_H_
+
+#include <AL/al.h>
+
+#include "al_buffer.h"
+
+/* Phases of the conversion filter kept in its table, rates needing
+   more interpolate between neighbouring ones */
+#define _AL_RATE_PHASES 256
+
+/* Zero crossings of the filter on each side of its centre, at the
+   lower of the two rates */
+#define _AL_RATE_ZEROS 16
+
+/* Convert the buffer's samples to rate on the conversion thread, the
+   new samples replace the old ones when it is done */
+ALvoid _alRateSchedule(AL_buffer *, ALuint rate);
+
+/* Drop a conversion not yet done, waiting for one being done */
+ALvoid _alRateCancel(AL_buffer *);
+
+/* Finish a conversion now, before a source is given the buffer */
+ALvoid _alRateFinish(AL_buffer *);
+
+#endif
@@ -25,24 +25,97 @@
 #include "al_error.h"
 #include "alc_device.h"
 #include "alc_context.h"
+#include "al_command.h"
 
-#define AL_FIRST_SOURCE_ID 0x4000
 
-AL_source *_alFindSource(AL_context *ctx, ALuint cid)
+AL_source *_alFindSource(AL_context *ctx, ALuint sid)
 {
-	cid -= AL_FIRST_SOURCE_ID;
+	AL_source *src;
+	ALuint slot = (sid & _AL_SOURCE_SLOT_MASK) - AL_FIRST_SOURCE_ID;
 
-	if (cid >= ctx->device->subdevs)
+	if (slot >= ctx->source_slots || !(src = ctx->sources[slot]) ||
+	    src->id != sid)
 	{
 		return 0;
 	}
 
-	return ctx->sources[cid];
+	return src;
+}
+
+/* Double the table, the mixer is sent a copy of its own to fill in */
+static ALboolean _alGrowSources(AL_context *ctx)
+{
+	AL_source **sources;
+	ALuint *generations;
+	ALuint slots, i;
+	AL_command cmd;
+
+	if (ctx->source_slots >= _AL_SOURCE_SLOTS)
+	{
+		return AL_FALSE;
+	}
+
+	slots = ctx->source_slots ? ctx->source_slots * 2 : 64;
+
+	if (slots > _AL_SOURCE_SLOTS)
+	{
+		slots = _AL_SOURCE_SLOTS;
+	}
+
+	if (!(sources = realloc(ctx->sources, slots * sizeof(AL_source *))))
+	{
+		return AL_FALSE;
+	}
+
+	ctx->sources = sources;
+
+	if (!(generations = realloc(ctx->generations, slots * sizeof(ALuint))))
+	{
+		return AL_FALSE;
+	}
+
+	ctx->generations = generations;
+
+	if (!(cmd.u.table.sources = calloc(slots, sizeof(AL_source *))))
+	{
+		return AL_FALSE;
+	}
+
+	for (i = ctx->source_slots; i < slots; i++)
+	{
+		ctx->sources[i] = 0;
+		ctx->generations[i] = 0;
+	}
+
+	ctx->source_slots = slots;
+
+	cmd.type = _AL_CMD_SOURCE_TABLE;
+	cmd.source = 0;
+	cmd.u.table.slots = slots;
+	_alSendCommand(ctx, &cmd);
+
+	return AL_TRUE;
 }
 
 static AL_source *_alGenSource(AL_context *ctx)
 {
 	AL_source *src;
+	AL_command cmd;
+	ALuint slot;
+
+	for (slot = ctx->free_source; slot < ctx->source_slots; slot++)
+	{
+		if (!ctx->sources[slot])
+		{
+			break;
+		}
+	}
+
+	if (slot == ctx->source_slots && !_alGrowSources(ctx))
+	{
+		_alSetError(AL_OUT_OF_MEMORY);
+		return 0;
+	}
 
 	if (!(src = malloc(sizeof(AL_source))))
 	{
@@ -51,86 +124,166 @@ static AL_source *_alGenSource(AL_context *ctx)
 	}
 
 	src->context = ctx;
+	src->slot = slot;
+	src->id = (ctx->generations[slot] << _AL_SOURCE_SLOT_BITS) |
+		  (slot + AL_FIRST_SOURCE_ID);
 	src->handle = 0;
-	src->subdev = -1;
 	src->freq = 0;
 	src->periods = 0;
+	src->buffer_size = 0;
+	src->period_size = 0;
+	src->wakeup = 0;
 
-	src->state = AL_INITIAL;
-	src->playing = AL_FALSE;
+	src->voice = AL_FALSE;
 	src->buffer = 0;
-	src->index = 0;
-
+	src->queue = 0;
+	src->queue_mask = 0;
 	src->first_q = 0;
+	src->last_q = 0;
+
+	src->status = _alSourceStatus(0, AL_INITIAL);
+
+	src->state = AL_INITIAL;
+	src->serial = 0;
+	src->playing = AL_FALSE;
+	src->mix_buffer = 0;
+	src->mix_queue = 0;
+	src->mix_queue_mask = 0;
+	src->cursor = 0;
 	src->current_q = 0;
-	src->last_q = &src->first_q;
+	src->last_mix_q = 0;
+	src->decoder.buffer = 0;
+	src->seam_q = 0;
+	src->seam_channels = 0;
 
-	if (!_alcOpenSource(src))
-	{
-		_alcCloseSource(src);
-		free(src);
-		_alSetError(AL_OUT_OF_MEMORY);
-		return 0;
-	}
+	_alcInitSource(src);
+
+	src->param.relative = AL_FALSE;
+	src->param.looping = AL_FALSE;
+	src->param.conic = AL_FALSE;
+
+	src->param.position[0] = 0.0f;
+	src->param.position[1] = 0.0f;
+	src->param.position[2] = 0.0f;
 
-	src->relative = AL_FALSE;
-	src->looping = AL_FALSE;
-	src->conic = AL_FALSE;
+	src->param.direction[0] = 0.0f;
+	src->param.direction[1] = 0.0f;
+	src->param.direction[2] = 0.0f;
 
-	src->position[0] = 0.0f;
-	src->position[1] = 0.0f;
-	src->position[2] = 0.0f;
+	src->param.velocity[0] = 0.0f;
+	src->param.velocity[1] = 0.0f;
+	src->param.velocity[2] = 0.0f;
 
-	src->direction[0] = 0.0f;
-	src->direction[1] = 0.0f;
-	src->direction[2] = 0.0f;
+	src->param.pitch = 1.0f;
+	src->param.gain = 1.0f;
+	src->param.min_gain = 0.0f;
+	src->param.max_gain = 1.0f;
+	src->param.reference_distance = 1.0f;
+	src->param.rolloff_factor = 1.0f;
+	src->param.max_distance = FLT_MAX;
+	src->param.cone_inner_angle = 360.0f;
+	src->param.cone_outer_angle = 360.0f;
+	src->param.cone_outer_gain = 0.0f;
 
-	src->velocity[0] = 0.0f;
-	src->velocity[1] = 0.0f;
-	src->velocity[2] = 0.0f;
+	src->mix_param = src->param;
 
-	src->pitch = 1.0f;
-	src->gain = 1.0f;
-	src->min_gain = 0.0f;
-	src->max_gain = 1.0f;
-	src->reference_distance = 1.0f;
-	src->rolloff_factor = 1.0f;
-	src->max_distance = FLT_MAX;
-	src->cone_inner_angle = 360.0f;
-	src->cone_outer_angle = 360.0f;
-	src->cone_outer_gain = 0.0f;
+	ctx->sources[slot] = src;
+	ctx->free_source = slot + 1;
 
-	ctx->sources[src->subdev] = src;
+	cmd.type = _AL_CMD_ADD_SOURCE;
+	cmd.source = src;
+	_alSendCommand(ctx, &cmd);
 
 	return src;
 }
 
+/* Called by the API, the mixer frees the source once it has let go */
 ALvoid _alDeleteSource(AL_source *src)
 {
-	AL_queue *que;
 	AL_context *ctx = src->context;
+	AL_command cmd;
 
-	_alSourceStop(src);
-	ctx->sources[src->subdev] = 0;
-	_alcCloseSource(src);
+	ctx->sources[src->slot] = 0;
+	ctx->generations[src->slot] = (ctx->generations[src->slot] + 1) &
+				      (0xFFFFFFFF >> _AL_SOURCE_SLOT_BITS);
 
-	que = src->first_q;
-	while (que)
+	if (ctx->free_source > src->slot)
 	{
-		AL_queue *next = que->next;
-		_alUnlockBuffer(que->buffer);		
-		free(que);
-		que = next;
+		ctx->free_source = src->slot;
+	}
+
+	if (src->voice)
+	{
+		ctx->device->count--;
 	}
 
 	if (src->buffer)
 	{
+		if (src->buffer->stream)
+		{
+			_alUnclaimStream(src->buffer);
+		}
+
 		_alUnlockBuffer(src->buffer);
+		src->buffer = 0;
+	}
+
+	cmd.type = _AL_CMD_DELETE_SOURCE;
+	cmd.source = src;
+	_alSendCommand(ctx, &cmd);
+
+	/* Have the mixer thread give back the pcm now */
+	if (src->voice)
+	{
+		_alcWakeContext(ctx);
+	}
+}
+
+/* Called by the mixer */
+ALvoid _alDestroySource(AL_source *src)
+{
+	AL_context *ctx = src->context;
+	ALuint i;
+
+	_alSourceTransport(src, AL_STOPPED, src->serial);
+
+	if (ctx->mix_sources[src->slot] == src)
+	{
+		ctx->mix_sources[src->slot] = 0;
+	}
+
+	_alcCloseSource(src);
+
+	/* The last ring the API sent is the one it used */
+	for (i = src->first_q; i != src->last_q; i++)
+	{
+		_alUnlockBuffer(src->mix_queue[i & src->mix_queue_mask]);
+	}
+
+	if (src->mix_queue)
+	{
+		free(src->mix_queue);
+	}
+
+	if (src->mix_buffer)
+	{
+		_alReleaseBuffer(src->mix_buffer);
 	}
 
 	free(src);
 }
 
+static ALvoid _alSendSourceParams(AL_context *ctx, AL_source *src)
+{
+	AL_command cmd;
+
+	cmd.type = _AL_CMD_SOURCE_PARAMS;
+	cmd.source = src;
+	cmd.u.params = src->param;
+
+	_alSendCommand(ctx, &cmd);
+}
+
 ALvoid alGenSources(ALsizei n, ALuint *sources)
 {
 	AL_context *ctx;
@@ -173,7 +326,7 @@ ALvoid alGenSources(ALsizei n, ALuint *sources)
 
 	for (i = 0; i < n; i++)
 	{
-		sources[i] = temp[i]->subdev + AL_FIRST_SOURCE_ID;
+		sources[i] = temp[i]->id;
 	}
 
 unlock:
@@ -247,18 +400,18 @@ ALboolean alIsSource(ALuint sid)
 
 static ALvoid _alNormalizeDirection(AL_source *src)
 {
-	ALfloat mag = _alVectorMagnitude(src->direction);
+	ALfloat mag = _alVectorMagnitude(src->param.direction);
 
 	if (mag)
 	{
-		src->conic = AL_TRUE;
-		src->direction[0] /= mag;
-		src->direction[1] /= mag;
-		src->direction[2] /= mag;
+		src->param.conic = AL_TRUE;
+		src->param.direction[0] /= mag;
+		src->param.direction[1] /= mag;
+		src->param.direction[2] /= mag;
 	}
 	else
 	{
-		src->conic = AL_FALSE;
+		src->param.conic = AL_FALSE;
 	}
 }
 
@@ -284,52 +437,63 @@ ALvoid alSourcei(ALuint sid, ALenum param, ALint value)
 	switch(param)
 	{
 	case AL_SOURCE_RELATIVE:
-		_alRangedAssignB(src->relative, value);
+		_alRangedAssignB(src->param.relative, value);
 		break;
 	case AL_LOOPING:
-		_alRangedAssignB(src->looping, value);
+		_alRangedAssignB(src->param.looping, value);
 		break;
 	case AL_PITCH:
-		_alRangedAssign1(src->pitch, value, 0);
+		_alRangedAssign1(src->param.pitch, value, 0);
 		break;
 	case AL_GAIN:
-		_alRangedAssign1(src->gain, value, 0);
+		_alRangedAssign1(src->param.gain, value, 0);
 		break;
 	case AL_MIN_GAIN:
-		_alRangedAssign2(src->min_gain, value, 0, 1);
+		_alRangedAssign2(src->param.min_gain, value, 0, 1);
 		break;
 	case AL_MAX_GAIN:
-		_alRangedAssign2(src->max_gain, value, 0, 1);
+		_alRangedAssign2(src->param.max_gain, value, 0, 1);
 		break;
 	case AL_REFERENCE_DISTANCE:	
-		_alRangedAssign1(src->reference_distance, value, 0);
+		_alRangedAssign1(src->param.reference_distance, value, 0);
 		break;
 	case AL_ROLLOFF_FACTOR:
-		_alRangedAssign1(src->rolloff_factor, value, 0);
+		_alRangedAssign1(src->param.rolloff_factor, value, 0);
 		break;
 	case AL_MAX_DISTANCE:
-		_alRangedAssign1(src->max_distance, value, 0);
+		_alRangedAssign1(src->param.max_distance, value, 0);
 		break;
 	case AL_CONE_INNER_ANGLE:
-		_alRangedAssign2(src->cone_inner_angle, value, 0, 360);
+		_alRangedAssign2(src->param.cone_inner_angle, value, 0, 360);
 		break;
 	case AL_CONE_OUTER_ANGLE:
-		_alRangedAssign2(src->cone_outer_angle, value, 0, 360);
+		_alRangedAssign2(src->param.cone_outer_angle, value, 0, 360);
 		break;
 	case AL_CONE_OUTER_GAIN:
-		_alRangedAssign2(src->cone_outer_gain, value, 0, 1);
+		_alRangedAssign2(src->param.cone_outer_gain, value, 0, 1);
 		break;
 	case AL_BUFFER:
 		{
 			AL_buffer *buf;
+			AL_command cmd;
 
 			if (value)
 			{
-				if (!(buf = _alLockBuffer(value)))
+				if (!(buf = _alUseBuffer(value)))
 				{
 					_alSetError(AL_INVALID_VALUE);
-					break;
+					goto unlock;
+				}
+
+				if (buf->stream && buf != src->buffer &&
+				    !_alClaimStream(buf))
+				{
+					_alUnlockBuffer(buf);
+					_alSetError(AL_INVALID_OPERATION);
+					goto unlock;
 				}
+
+				_alRetainBuffer(buf);
 			}
 			else
 			{
@@ -338,17 +502,30 @@ ALvoid alSourcei(ALuint sid, ALenum param, ALint value)
 
 			if (src->buffer)
 			{
+				if (src->buffer->stream && src->buffer != buf)
+				{
+					_alUnclaimStream(src->buffer);
+				}
+
 				_alUnlockBuffer(src->buffer);
 			}
 
 			src->buffer = buf;
+
+			/* The mixer's reference goes with the command */
+			cmd.type = _AL_CMD_SOURCE_BUFFER;
+			cmd.source = src;
+			cmd.u.buffer = buf;
+			_alSendCommand(ctx, &cmd);
 		}
-		break;
+		goto unlock;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
 	}
 
+	_alSendSourceParams(ctx, src);
+
 unlock:
 	_alcUnlockContext(ctx);
 }
@@ -375,46 +552,48 @@ ALvoid alSourcef(ALuint sid, ALenum param, ALfloat value)
 	switch(param)
 	{
 	case AL_SOURCE_RELATIVE:
-		_alRangedAssignB(src->relative, value);
+		_alRangedAssignB(src->param.relative, value);
 		break;
 	case AL_LOOPING:
-		_alRangedAssignB(src->looping, value);
+		_alRangedAssignB(src->param.looping, value);
 		break;
 	case AL_PITCH:
-		_alRangedAssign1(src->pitch, value, 0.0f);
+		_alRangedAssign1(src->param.pitch, value, 0.0f);
 		break;
 	case AL_GAIN:
-		_alRangedAssign1(src->gain, value, 0.0f);
+		_alRangedAssign1(src->param.gain, value, 0.0f);
 		break;
 	case AL_MIN_GAIN:
-		_alRangedAssign2(src->min_gain, value, 0.0f, 1.0f);
+		_alRangedAssign2(src->param.min_gain, value, 0.0f, 1.0f);
 		break;
 	case AL_MAX_GAIN:
-		_alRangedAssign2(src->max_gain, value, 0.0f, 1.0f);
+		_alRangedAssign2(src->param.max_gain, value, 0.0f, 1.0f);
 		break;
 	case AL_REFERENCE_DISTANCE:	
-		_alRangedAssign1(src->reference_distance, value, 0.0f);
+		_alRangedAssign1(src->param.reference_distance, value, 0.0f);
 		break;
 	case AL_ROLLOFF_FACTOR:
-		_alRangedAssign1(src->rolloff_factor, value, 0.0f);
+		_alRangedAssign1(src->param.rolloff_factor, value, 0.0f);
 		break;
 	case AL_MAX_DISTANCE:
-		_alRangedAssign1(src->max_distance, value, 0.0f);
+		_alRangedAssign1(src->param.max_distance, value, 0.0f);
 		break;
 	case AL_CONE_INNER_ANGLE:
-		_alRangedAssign2(src->cone_inner_angle, value, 0.0f, 360.0f);
+		_alRangedAssign2(src->param.cone_inner_angle, value, 0.0f, 360.0f);
 		break;
 	case AL_CONE_OUTER_ANGLE:
-		_alRangedAssign2(src->cone_outer_angle, value, 0.0f, 360.0f);
+		_alRangedAssign2(src->param.cone_outer_angle, value, 0.0f, 360.0f);
 		break;
 	case AL_CONE_OUTER_GAIN:
-		_alRangedAssign2(src->cone_outer_gain, value, 0.0f, 1.0f);
+		_alRangedAssign2(src->param.cone_outer_gain, value, 0.0f, 1.0f);
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
 	}
 
+	_alSendSourceParams(ctx, src);
+
 unlock:
 	_alcUnlockContext(ctx);
 }
@@ -441,26 +620,28 @@ ALvoid alSource3f(ALuint sid, ALenum param, ALfloat f1, ALfloat f2, ALfloat f3)
 	switch(param)
 	{
 	case AL_POSITION:
-		src->position[0] = f1;
-		src->position[1] = f2;
-		src->position[2] = f3;
+		src->param.position[0] = f1;
+		src->param.position[1] = f2;
+		src->param.position[2] = f3;
 		break;
 	case AL_DIRECTION:
-		src->direction[0] = f1;
-		src->direction[1] = f2;
-		src->direction[2] = f3;
+		src->param.direction[0] = f1;
+		src->param.direction[1] = f2;
+		src->param.direction[2] = f3;
 		_alNormalizeDirection(src);
 		break;
 	case AL_VELOCITY:
-		src->velocity[0] = f1;
-		src->velocity[1] = f2;
-		src->velocity[2] = f3;
+		src->param.velocity[0] = f1;
+		src->param.velocity[1] = f2;
+		src->param.velocity[2] = f3;
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
 	}
 
+	_alSendSourceParams(ctx, src);
+
 unlock:
 	_alcUnlockContext(ctx);
 }
@@ -487,96 +668,88 @@ ALvoid alSourcefv(ALuint sid, ALenum param, ALfloat *values)
 	switch(param)
 	{
 	case AL_SOURCE_RELATIVE:
-		_alRangedAssignB(src->relative, values[0]);
+		_alRangedAssignB(src->param.relative, values[0]);
 		break;
 	case AL_LOOPING:
-		_alRangedAssignB(src->looping, values[0]);
+		_alRangedAssignB(src->param.looping, values[0]);
 		break;
 	case AL_PITCH:
-		_alRangedAssign1(src->pitch, values[0], 0.0f);
+		_alRangedAssign1(src->param.pitch, values[0], 0.0f);
 		break;
 	case AL_GAIN:
-		_alRangedAssign1(src->gain, values[0], 0.0f);
+		_alRangedAssign1(src->param.gain, values[0], 0.0f);
 		break;
 	case AL_MIN_GAIN:
-		_alRangedAssign2(src->min_gain, values[0], 0.0f, 1.0f);
+		_alRangedAssign2(src->param.min_gain, values[0], 0.0f, 1.0f);
 		break;
 	case AL_MAX_GAIN:
-		_alRangedAssign2(src->max_gain, values[0], 0.0f, 1.0f);
+		_alRangedAssign2(src->param.max_gain, values[0], 0.0f, 1.0f);
 		break;
 	case AL_REFERENCE_DISTANCE:	
-		_alRangedAssign1(src->reference_distance, values[0], 0.0f);
+		_alRangedAssign1(src->param.reference_distance, values[0], 0.0f);
 		break;
 	case AL_ROLLOFF_FACTOR:
-		_alRangedAssign1(src->rolloff_factor, values[0], 0.0f);
+		_alRangedAssign1(src->param.rolloff_factor, values[0], 0.0f);
 		break;
 	case AL_MAX_DISTANCE:
-		_alRangedAssign1(src->max_distance, values[0], 0.0f);
+		_alRangedAssign1(src->param.max_distance, values[0], 0.0f);
 		break;
 	case AL_CONE_INNER_ANGLE:
-		_alRangedAssign2(src->cone_inner_angle, values[0],
+		_alRangedAssign2(src->param.cone_inner_angle, values[0],
 				 0.0f, 360.0f);
 		break;
 	case AL_CONE_OUTER_ANGLE:
-		_alRangedAssign2(src->cone_outer_angle, values[0],
+		_alRangedAssign2(src->param.cone_outer_angle, values[0],
 				 0.0f, 360.0f);
 		break;
 	case AL_CONE_OUTER_GAIN:
-		_alRangedAssign2(src->cone_outer_gain, values[0], 0.0f, 1.0f);
+		_alRangedAssign2(src->param.cone_outer_gain, values[0], 0.0f, 1.0f);
 		break;
 	case AL_POSITION:
-		src->position[0] = values[0];
-		src->position[1] = values[1];
-		src->position[2] = values[2];
+		src->param.position[0] = values[0];
+		src->param.position[1] = values[1];
+		src->param.position[2] = values[2];
 		break;
 	case AL_DIRECTION:
-		src->direction[0] = values[0];
-		src->direction[1] = values[1];
-		src->direction[2] = values[2];
+		src->param.direction[0] = values[0];
+		src->param.direction[1] = values[1];
+		src->param.direction[2] = values[2];
 		_alNormalizeDirection(src);
 		break;
 	case AL_VELOCITY:
-		src->velocity[0] = values[0];
-		src->velocity[1] = values[1];
-		src->velocity[2] = values[2];
+		src->param.velocity[0] = values[0];
+		src->param.velocity[1] = values[1];
+		src->param.velocity[2] = values[2];
 		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
 	}
 
+	_alSendSourceParams(ctx, src);
+
 unlock:
 	_alcUnlockContext(ctx);
 }
 
 static ALint _alBuffersQueued(AL_source *src)
 {
-	AL_queue *q;
-	ALint count = 0;
-
-	for (q = src->first_q; q; q = q->next)
-	{
-		count++;
-	}
-
-	return count;
+	return (ALint)(src->last_q - src->first_q);
 }
 
 static ALint _alBuffersProcessed(AL_source *src)
 {
-	AL_queue *q;
-	ALint count = 0;
-
-	for (q = src->first_q; q; q = q->next)
-	{
-		if (q->state != AL_PROCESSED)
-		{
-			break;
-		}
-		count++;
-	}
+	return (ALint)(__atomic_load_n(&src->current_q, __ATOMIC_ACQUIRE) -
+		       src->first_q);
+}
 
-	return count;
+/* The frame of its buffer the mixer reads next.  The cursor is only
+   written by the mixer, a 64 bit load sees either the old or the new
+   value. */
+static ALuint _alSourceOffset(AL_source *src)
+{
+	return (ALuint)(__atomic_load_n(&src->cursor, __ATOMIC_RELAXED) >>
+			_AL_FRAC_BITS);
 }
 
 ALvoid alGetSourcei(ALuint sid, ALenum param, ALint *value)
@@ -610,58 +783,58 @@ ALvoid alGetSourceiv(ALuint sid, ALenum param, ALint *values)
 	switch(param)
 	{
 	case AL_SOURCE_RELATIVE:
-		values[0] = src->relative;
+		values[0] = src->param.relative;
 		break;
 	case AL_SOURCE_STATE:
-		values[0] = src->state;
+		values[0] = _alSourceState(src);
 		break;
 	case AL_LOOPING:
-		values[0] = src->looping;
+		values[0] = src->param.looping;
 		break;
 	case AL_PITCH:
-		values[0] = (ALint)src->pitch;
+		values[0] = (ALint)src->param.pitch;
 		break;
 	case AL_GAIN:
-		values[0] = (ALint)src->gain;
+		values[0] = (ALint)src->param.gain;
 		break;
 	case AL_MIN_GAIN:
-		values[0] = (ALint)src->min_gain;
+		values[0] = (ALint)src->param.min_gain;
 		break;
 	case AL_MAX_GAIN:
-		values[0] = (ALint)src->max_gain;
+		values[0] = (ALint)src->param.max_gain;
 		break;
 	case AL_REFERENCE_DISTANCE:
-		values[0] = (ALint)src->reference_distance;
+		values[0] = (ALint)src->param.reference_distance;
 		break;
 	case AL_ROLLOFF_FACTOR:
-		values[0] = (ALint)src->rolloff_factor;
+		values[0] = (ALint)src->param.rolloff_factor;
 		break;
 	case AL_MAX_DISTANCE:
-		values[0] = (ALint)src->max_distance;
+		values[0] = (ALint)src->param.max_distance;
 		break;
 	case AL_CONE_INNER_ANGLE:
-		values[0] = (ALint)src->cone_inner_angle;
+		values[0] = (ALint)src->param.cone_inner_angle;
 		break;
 	case AL_CONE_OUTER_ANGLE:
-		values[0] = (ALint)src->cone_outer_angle;
+		values[0] = (ALint)src->param.cone_outer_angle;
 		break;
 	case AL_CONE_OUTER_GAIN:
-		values[0] = (ALint)src->cone_outer_gain;
+		values[0] = (ALint)src->param.cone_outer_gain;
 		break;
 	case AL_POSITION:
-		values[0] = (ALint)src->position[0];
-		values[1] = (ALint)src->position[1];
-		values[2] = (ALint)src->position[2];
+		values[0] = (ALint)src->param.position[0];
+		values[1] = (ALint)src->param.position[1];
+		values[2] = (ALint)src->param.position[2];
 		break;
 	case AL_DIRECTION:
-		values[0] = (ALint)src->direction[0];
-		values[1] = (ALint)src->direction[1];
-		values[2] = (ALint)src->direction[2];
+		values[0] = (ALint)src->param.direction[0];
+		values[1] = (ALint)src->param.direction[1];
+		values[2] = (ALint)src->param.direction[2];
 		break;
 	case AL_VELOCITY:
-		values[0] = (ALint)src->velocity[0];
-		values[1] = (ALint)src->velocity[1];
-		values[2] = (ALint)src->velocity[2];
+		values[0] = (ALint)src->param.velocity[0];
+		values[1] = (ALint)src->param.velocity[1];
+		values[2] = (ALint)src->param.velocity[2];
 		break;
 	case AL_BUFFER:
 		values[0] = src->buffer ? src->buffer->id : 0;
@@ -672,6 +845,9 @@ ALvoid alGetSourceiv(ALuint sid, ALenum param, ALint *values)
 	case AL_BUFFERS_PROCESSED:
 		values[0] = _alBuffersProcessed(src);
 		break;
+	case AL_SAMPLE_OFFSET:
+		values[0] = (ALint)_alSourceOffset(src);
+		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
@@ -728,58 +904,58 @@ ALvoid alGetSourcefv(ALuint sid, ALenum param, ALfloat* values)
 	switch(param)
 	{
 	case AL_SOURCE_RELATIVE:
-		values[0] = src->relative;
+		values[0] = src->param.relative;
 		break;
 	case AL_SOURCE_STATE:
-		values[0] = (ALfloat)src->state;
+		values[0] = (ALfloat)_alSourceState(src);
 		break;
 	case AL_LOOPING:
-		values[0] = (ALfloat)src->looping;
+		values[0] = (ALfloat)src->param.looping;
 		break;
 	case AL_PITCH:
-		values[0] = src->pitch;
+		values[0] = src->param.pitch;
 		break;
 	case AL_GAIN:
-		values[0] = src->gain;
+		values[0] = src->param.gain;
 		break;
 	case AL_MIN_GAIN:
-		values[0] = src->min_gain;
+		values[0] = src->param.min_gain;
 		break;
 	case AL_MAX_GAIN:
-		values[0] = src->max_gain;
+		values[0] = src->param.max_gain;
 		break;
 	case AL_REFERENCE_DISTANCE:
-		values[0] = src->reference_distance;
+		values[0] = src->param.reference_distance;
 		break;
 	case AL_ROLLOFF_FACTOR:
-		values[0] = src->rolloff_factor;
+		values[0] = src->param.rolloff_factor;
 		break;
 	case AL_MAX_DISTANCE:
-		values[0] = src->max_distance;
+		values[0] = src->param.max_distance;
 		break;
 	case AL_CONE_INNER_ANGLE:
-		values[0] = src->cone_inner_angle;
+		values[0] = src->param.cone_inner_angle;
 		break;
 	case AL_CONE_OUTER_ANGLE:
-		values[0] = src->cone_outer_angle;
+		values[0] = src->param.cone_outer_angle;
 		break;
 	case AL_CONE_OUTER_GAIN:
-		values[0] = src->cone_outer_gain;
+		values[0] = src->param.cone_outer_gain;
 		break;
 	case AL_POSITION:
-		values[0] = src->position[0];
-		values[1] = src->position[1];
-		values[2] = src->position[2];
+		values[0] = src->param.position[0];
+		values[1] = src->param.position[1];
+		values[2] = src->param.position[2];
 		break;
 	case AL_DIRECTION:
-		values[0] = src->direction[0];
-		values[1] = src->direction[1];
-		values[2] = src->direction[2];
+		values[0] = src->param.direction[0];
+		values[1] = src->param.direction[1];
+		values[2] = src->param.direction[2];
 		break;
 	case AL_VELOCITY:
-		values[0] = src->velocity[0];
-		values[1] = src->velocity[1];
-		values[2] = src->velocity[2];
+		values[0] = src->param.velocity[0];
+		values[1] = src->param.velocity[1];
+		values[2] = src->param.velocity[2];
 		break;
 	case AL_BUFFERS_QUEUED:
 		values[0] = (ALfloat)_alBuffersQueued(src);
@@ -787,6 +963,9 @@ ALvoid alGetSourcefv(ALuint sid, ALenum param, ALfloat* values)
 	case AL_BUFFERS_PROCESSED:
 		values[0] = (ALfloat)_alBuffersProcessed(src);
 		break;
+	case AL_SAMPLE_OFFSET:
+		values[0] = (ALfloat)_alSourceOffset(src);
+		break;
 	default:
 		_alSetError(AL_INVALID_ENUM);
 		break;
@@ -796,13 +975,45 @@ unlock:
 	_alcUnlockContext(ctx);
 }
 
+/* A ring twice the size holding the entries up to last where they
+   were, the mixer frees the old one once it has the new */
+static ALboolean _alGrowQueue(AL_context *ctx, AL_source *src, ALuint last)
+{
+	AL_buffer **entries;
+	ALuint size, i;
+	AL_command cmd;
+
+	size = src->queue ? (src->queue_mask + 1) * 2 : _AL_QUEUE_MIN;
+
+	if (!size || !(entries = malloc(size * sizeof(AL_buffer *))))
+	{
+		return AL_FALSE;
+	}
+
+	for (i = src->first_q; i != last; i++)
+	{
+		entries[i & (size - 1)] = src->queue[i & src->queue_mask];
+	}
+
+	src->queue = entries;
+	src->queue_mask = size - 1;
+
+	cmd.type = _AL_CMD_SOURCE_RING;
+	cmd.source = src;
+	cmd.u.ring.entries = entries;
+	cmd.u.ring.mask = size - 1;
+	_alSendCommand(ctx, &cmd);
+
+	return AL_TRUE;
+}
+
 ALvoid alSourceQueueBuffers(ALuint sid, ALsizei n, ALuint *buffers)
 {
 	AL_context *ctx;
 	AL_source *src;
 	ALsizei i;
-	AL_queue *first_q;
-	AL_queue **last_q;
+	ALuint last;
+	AL_command cmd;
 
 	if (n == 0)
 	{
@@ -829,55 +1040,55 @@ ALvoid alSourceQueueBuffers(ALuint sid, ALsizei n, ALuint *buffers)
 		goto unlock;
 	}
 
-	first_q = 0;
-	last_q = &first_q;
+	/* The new entries only count once they are all in */
+	last = src->last_q;
 
 	for (i = 0; i < n; i++)
 	{
 		AL_buffer *buf;
-		AL_queue *que;
 
 		if (!buffers[i])
 			continue;
 
-		if (!(buf = _alLockBuffer(buffers[i])))
+		if ((!src->queue || last - src->first_q > src->queue_mask) &&
+		    !_alGrowQueue(ctx, src, last))
 		{
-			while ((que = first_q))
-			{
-				first_q = que->next;
-				_alUnlockBuffer(que->buffer);
-				free(que);
-			}
-
-			_alSetError(AL_INVALID_NAME);
-			goto unlock;
+			_alSetError(AL_OUT_OF_MEMORY);
+			break;
 		}
 
-		if (!(que = malloc(sizeof(AL_queue))))
+		/* Rings play on for ever, they can't be queued */
+		if (!(buf = _alUseBuffer(buffers[i])) || buf->stream)
 		{
-			while ((que = first_q))
+			if (buf)
 			{
-				first_q = que->next;
-				_alUnlockBuffer(que->buffer);
-				free(que);
+				_alUnlockBuffer(buf);
 			}
 
-			_alSetError(AL_OUT_OF_MEMORY);
-			goto unlock;
+			_alSetError(buf ? AL_INVALID_OPERATION :
+				    AL_INVALID_NAME);
+			break;
 		}
 
-		que->next = 0;
-		que->buffer = buf;
-		que->state = AL_PENDING;
-
-		*last_q = que;
-		last_q = &que->next;
+		src->queue[last++ & src->queue_mask] = buf;
 	}
 
-	if (first_q)
+	if (i < n)
 	{
-		*src->last_q = first_q;
-		src->last_q = last_q;
+		while (last != src->last_q)
+		{
+			_alUnlockBuffer(src->queue[--last & src->queue_mask]);
+		}
+	}
+	else if (last != src->last_q)
+	{
+		src->last_q = last;
+
+		/* The mixer only plays up to the entries it has been told of */
+		cmd.type = _AL_CMD_SOURCE_QUEUE;
+		cmd.source = src;
+		cmd.u.queue = last;
+		_alSendCommand(ctx, &cmd);
 	}
 
 unlock:
@@ -924,14 +1135,11 @@ ALvoid alSourceUnqueueBuffers(ALuint sid, ALsizei n, ALuint *buffers)
 
 	for (i = 0; i < n; i++)
 	{
-		AL_queue *que = src->first_q;
-
-		src->first_q = que->next;
+		AL_buffer *buf = src->queue[src->first_q++ & src->queue_mask];
 
-		buffers[i] = que->buffer->id;
+		buffers[i] = buf->id;
 
-		_alUnlockBuffer(que->buffer);
-		free(que);
+		_alUnlockBuffer(buf);
 	}
 
 unlock:
@@ -20,43 +20,33 @@
 #ifndef _AL_SOURCE_H_
 #define _AL_SOURCE_H_
 
+#include <stdint.h>
 #include <alsa/asoundlib.h>
 
 #include <AL/al.h>
 #include <AL/alc.h>
 
 #include "al_buffer.h"
-
-typedef struct _AL_queue 
-{
-	struct _AL_queue *next;
-	AL_buffer *buffer;
-	ALenum state;
-}
-AL_queue;
-
-typedef struct _AL_source
+#include "al_adpcm.h"
+
+/* Source ids are AL_FIRST_SOURCE_ID plus the slot in the context's
+   table in the low bits and the slot's generation above, so the id
+   of a deleted source stays invalid while its slot is used again */
+#define AL_FIRST_SOURCE_ID 0x4000
+#define _AL_SOURCE_SLOT_BITS 20
+#define _AL_SOURCE_SLOT_MASK ((1 << _AL_SOURCE_SLOT_BITS) - 1)
+#define _AL_SOURCE_SLOTS ((1 << _AL_SOURCE_SLOT_BITS) - AL_FIRST_SOURCE_ID)
+
+/* A source's queue is a ring of a power of two entries, the API adds
+   at last_q and takes processed ones off at first_q, the mixer plays
+   the one at current_q.  A full ring is replaced by one twice the
+   size, which reaches the mixer through the command queue. */
+#define _AL_QUEUE_MIN 16
+
+/* The properties the mixer reads.  The API and the mixer each keep a
+   copy, the mixer's is only updated through the command queue. */
+typedef struct _AL_source_params
 {
-	ALCcontext *context;
-
-	snd_pcm_t *handle;
-	ALint subdev;
-	ALuint freq;
-	ALuint periods;
-
-	snd_pcm_sframes_t period_size;
-	double phase;
-	int first;	
-
-	ALenum state;
-	ALboolean playing;
-	AL_buffer *buffer;
-	ALfloat index;
-
-	AL_queue *first_q;
-	AL_queue **last_q;
-	AL_queue *current_q;
-
 	ALboolean relative;
 	ALboolean looping;
 	ALboolean conic;
@@ -75,14 +65,79 @@ typedef struct _AL_source
 	ALfloat cone_inner_angle;
 	ALfloat cone_outer_angle;
 	ALfloat cone_outer_gain;
+}
+AL_source_params;
+
+typedef struct _AL_source
+{
+	ALCcontext *context;
+	ALuint id;
+	ALuint slot;
+
+	/* Without the software mixer the pcm is opened when the source
+	   first plays and may be handed on once it has stopped.  The
+	   mixer owns these, they only change through the command queue. */
+	snd_pcm_t *handle;
+	ALuint freq;
+	ALuint periods;
+
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t period_size;
+	snd_pcm_uframes_t wakeup;
+	double phase;
+	int first;	
+
+	/* Owned by the API threads */
+	ALboolean voice;	/* has a pcm, or one is on its way to it */
+	AL_buffer *buffer;
+	AL_buffer **queue;
+	ALuint queue_mask;
+	ALuint first_q;
+	ALuint last_q;
+	AL_source_params param;
+
+	/* Transport serial in the upper half, state in the lower.  The
+	   API bumps the serial for every transport command, the mixer
+	   only stops a source whose serial it has caught up with. */
+	uint64_t status;
+
+	/* Owned by the mixer */
+	ALenum state;
+	ALuint serial;
+	ALboolean playing;
+	AL_buffer *mix_buffer;
+	AL_buffer mix_copy;	/* mix_buffer as this cycle plays it */
+	uint64_t cursor;	/* 32.32 fixed point frames */
+	AL_buffer **mix_queue;	/* queue as far as the mixer has been told */
+	ALuint mix_queue_mask;
+	ALuint current_q;	/* the entries before it are processed */
+	ALuint last_mix_q;	/* last_q as far as the mixer has been told */
+	AL_source_params mix_param;
+	AL_decoder decoder;
+
+	/* The last frames of the entry before seam_q, read back by the
+	   interpolators at the start of seam_q */
+	ALuint seam_q;
+	ALuint seam_channels;
+	ALfloat seam[_AL_MAX_LOAD][_AL_RESAMPLE_PRE];
+
+	ALfloat gain;		/* before the speakers' share */
 	ALfloat	volume[8];
 	int 	channels;		
 }
 AL_source;
 
+#define _alSourceStatus(serial, state) \
+	(((uint64_t)(serial) << 32) | (ALuint)(state))
+
+#define _alSourceState(src) \
+	((ALenum)(ALuint)__atomic_load_n(&(src)->status, __ATOMIC_ACQUIRE))
+
 ALvoid _alDeleteSource(AL_source *);
+ALvoid _alDestroySource(AL_source *);
 ALvoid _alProcessSource(AL_source *);
 
-extern ALvoid _alSourceStop(AL_source *src);
+ALvoid _alSourceTransport(AL_source *, ALenum, ALuint);
+ALvoid _alSourceQueue(AL_source *, ALuint);
 
 #endif
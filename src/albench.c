@@ -0,0 +1,405 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ *  Mixer benchmark.  Renders a fixed scene through a loopback device
+ *  for every combination of output layout, buffer format, pitch and
+ *  number of sources, and prints the cost per output frame.  Before
+ *  that it times converting buffer uploads.
+ *
+ *	albench [etc directory] [frames]
+ *
+ *  The etc directory holds the speakers-* layouts (../etc), frames is
+ *  how much is rendered for each line (44100).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <AL/alext.h>
+
+#define _BENCH_FREQ 44100
+#define _BENCH_BLOCK 1024
+#define _BENCH_SOURCES 1024
+
+static const struct
+{
+	ALuint channels;
+	const char *speakers;
+}
+_benchLayouts[] =
+{
+	{ 2, "speakers-stereo" },
+	{ 4, "speakers-quadraphonic" },
+	{ 6, "speakers-fivepoint-a" },
+	{ 8, "speakers-sevenpoint-a" }
+};
+
+static const struct
+{
+	ALenum format;
+	ALuint bytes;	/* per sample */
+	const char *name;
+}
+_benchFormats[] =
+{
+	{ AL_FORMAT_MONO16, 2, "mono16" },
+	{ AL_FORMAT_STEREO16, 2, "stereo16" },
+	{ AL_FORMAT_MONO8, 1, "mono8" },
+	{ AL_FORMAT_STEREO8, 1, "stereo8" }
+};
+
+#define _BENCH_FORMATS (sizeof(_benchFormats) / sizeof(_benchFormats[0]))
+
+static const ALuint _benchSources[] = { 1, 4, 16, 64, 256, 1024 };
+
+/* alBufferData and alBufferWriteData_LOKI paths, timed on a megabyte */
+#define _BENCH_UPLOAD (1 << 20)
+#define _BENCH_UPLOADS 64
+
+static const struct
+{
+	ALenum format;
+	ALenum internal;
+	const char *name;
+}
+_benchUploads[] =
+{
+	{ AL_FORMAT_STEREO16, AL_FORMAT_STEREO16, "copy 16 bit" },
+	{ AL_FORMAT_STEREO8, AL_FORMAT_STEREO8, "copy 8 bit" },
+	{ AL_FORMAT_STEREO8, AL_FORMAT_STEREO16, "widen 8 to 16 bit" },
+	{ AL_FORMAT_STEREO16, AL_FORMAT_STEREO8, "narrow 16 to 8 bit" },
+	{ AL_FORMAT_STEREO16_BE_EXT, AL_FORMAT_STEREO16, "swap big endian" }
+};
+
+/* 1.0 mixes without resampling, the others at fractional steps */
+static const ALfloat _benchPitches[] = { 1.0f, 0.5f, 1.2599f, 2.0f };
+
+/* Allocations made by the library while rendering.  glibc exports
+   its allocator under these names so it can be wrapped here. */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+static unsigned long _benchAllocs = 0;
+
+void *malloc(size_t size)
+{
+	_benchAllocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	_benchAllocs++;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	_benchAllocs++;
+	return __libc_realloc(p, size);
+}
+
+int posix_memalign(void **p, size_t align, size_t size)
+{
+	_benchAllocs++;
+	return (*p = __libc_memalign(align, size)) ? 0 : ENOMEM;
+}
+
+void free(void *p)
+{
+	__libc_free(p);
+}
+
+/* The library reads its configuration from $HOME, give it one made
+   up for each layout */
+static int _benchSetup(const char *home, const char *etc, ALuint layout)
+{
+	char buf[1024];
+	FILE *in, *out;
+	size_t n;
+
+	sprintf(buf, "%s/.openal-alsa", home);
+
+	if (!(out = fopen(buf, "w")))
+	{
+		return 0;
+	}
+
+	fprintf(out, "channels %u\n", _benchLayouts[layout].channels);
+	fclose(out);
+
+	sprintf(buf, "%s/%s", etc, _benchLayouts[layout].speakers);
+
+	if (!(in = fopen(buf, "r")))
+	{
+		return 0;
+	}
+
+	sprintf(buf, "%s/.openal-speakers", home);
+
+	if (!(out = fopen(buf, "w")))
+	{
+		fclose(in);
+		return 0;
+	}
+
+	while ((n = fread(buf, 1, sizeof(buf), in)))
+	{
+		fwrite(buf, 1, n, out);
+	}
+
+	fclose(in);
+	fclose(out);
+
+	return 1;
+}
+
+static double _benchNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Upload throughput, in bytes of input converted per second */
+static void _benchUpload(void)
+{
+	ALubyte *data;
+	ALuint buffer, u, i;
+
+	if (!(data = malloc(_BENCH_UPLOAD)))
+	{
+		return;
+	}
+
+	for (i = 0; i < _BENCH_UPLOAD; i++)
+	{
+		data[i] = rand();
+	}
+
+	alGenBuffers(1, &buffer);
+
+	printf("%-20s %8s\n", "upload", "GB/s");
+
+	for (u = 0; u < sizeof(_benchUploads) / sizeof(_benchUploads[0]); u++)
+	{
+		double start, ns;
+
+		alBufferWriteData_LOKI(buffer, _benchUploads[u].format, data,
+				       _BENCH_UPLOAD, _BENCH_FREQ,
+				       _benchUploads[u].internal);
+
+		start = _benchNow();
+
+		for (i = 0; i < _BENCH_UPLOADS; i++)
+		{
+			alBufferWriteData_LOKI(buffer, _benchUploads[u].format,
+					       data, _BENCH_UPLOAD, _BENCH_FREQ,
+					       _benchUploads[u].internal);
+		}
+
+		ns = _benchNow() - start;
+
+		printf("%-20s %8.2f\n", _benchUploads[u].name,
+		       (double)_BENCH_UPLOAD * _BENCH_UPLOADS / ns);
+	}
+
+	printf("\n");
+
+	alDeleteBuffers(1, &buffer);
+	free(data);
+}
+
+/* One line of the table: count sources spread around the listener */
+static void _benchRun(ALCcontext *ctx, ALuint channels, ALuint buffer,
+		      const char *format, ALfloat pitch, ALuint count,
+		      ALuint frames, ALshort *out)
+{
+	ALuint sources[_BENCH_SOURCES];
+	unsigned long allocs;
+	double start, ns;
+	ALuint i, n;
+
+	alGenSources(count, sources);
+
+	for (i = 0; i < count; i++)
+	{
+		ALfloat a = 2.0f * M_PI * i / count;
+
+		alSourcei(sources[i], AL_BUFFER, buffer);
+		alSourcei(sources[i], AL_LOOPING, AL_TRUE);
+		alSourcef(sources[i], AL_PITCH, pitch);
+		alSource3f(sources[i], AL_POSITION, sinf(a), 0.0f, -cosf(a));
+	}
+
+	alSourcePlayv(count, sources);
+
+	/* Let the commands through before timing */
+	alcRenderContext_EXT(ctx, out, _BENCH_BLOCK);
+
+	allocs = _benchAllocs;
+	start = _benchNow();
+
+	for (i = 0; i < frames; i += n)
+	{
+		n = frames - i;
+
+		if (n > _BENCH_BLOCK)
+		{
+			n = _BENCH_BLOCK;
+		}
+
+		alcRenderContext_EXT(ctx, out, n);
+	}
+
+	ns = (_benchNow() - start) / frames;
+	allocs = _benchAllocs - allocs;
+
+	printf("%8u %8s %6.3f %6u %12.1f %12.1f %8lu\n",
+	       channels, format, pitch, count, ns,
+	       count * 1e9 / _BENCH_FREQ / ns, allocs);
+
+	alDeleteSources(count, sources);
+}
+
+int main(int argc, char **argv)
+{
+	const char *etc = argc > 1 ? argv[1] : "../etc";
+	ALuint frames = argc > 2 ? (ALuint)atoi(argv[2]) : _BENCH_FREQ;
+	ALCint attr[] = { ALC_FREQUENCY, _BENCH_FREQ, 0 };
+	char home[] = "/tmp/albenchXXXXXX";
+	ALshort *data, *out;
+	ALuint layout, b, p, s;
+
+	if (!frames)
+	{
+		fprintf(stderr, "usage: %s [etc directory] [frames]\n", argv[0]);
+		return 1;
+	}
+
+	if (!mkdtemp(home))
+	{
+		perror(home);
+		return 1;
+	}
+
+	setenv("HOME", home, 1);
+
+	/* A second of noise, as stereo or twice as long as mono */
+	data = malloc(_BENCH_FREQ * 2 * sizeof(ALshort));
+	out = malloc(_BENCH_BLOCK * 8 * sizeof(ALshort));
+
+	if (!data || !out)
+	{
+		return 1;
+	}
+
+	srand(1);
+
+	for (s = 0; s < _BENCH_FREQ * 2; s++)
+	{
+		data[s] = (rand() & 0xffff) - 0x8000;
+	}
+
+	_benchUpload();
+
+	printf("%8s %8s %6s %6s %12s %12s %8s\n", "channels", "buffer",
+	       "pitch", "voices", "ns/frame", "voices/core", "allocs");
+
+	for (layout = 0; layout < sizeof(_benchLayouts) /
+		     sizeof(_benchLayouts[0]); layout++)
+	{
+		ALCdevice *dev;
+		ALCcontext *ctx;
+		ALuint buffers[_BENCH_FORMATS];
+
+		if (!_benchSetup(home, etc, layout))
+		{
+			fprintf(stderr, "can't set up %s from %s\n",
+				_benchLayouts[layout].speakers, etc);
+			continue;
+		}
+
+		if (!(dev = alcOpenLoopbackDevice_EXT(0)) ||
+		    !(ctx = alcCreateContext(dev, attr)))
+		{
+			fprintf(stderr, "can't open the loopback device\n");
+			return 1;
+		}
+
+		alcMakeContextCurrent(ctx);
+
+		alGenBuffers(_BENCH_FORMATS, buffers);
+
+		/* 8 bit buffers are as many samples of the same noise */
+		for (b = 0; b < _BENCH_FORMATS; b++)
+		{
+			alBufferData(buffers[b], _benchFormats[b].format, data,
+				     _BENCH_FREQ * 2 * _benchFormats[b].bytes,
+				     _BENCH_FREQ);
+		}
+
+		for (b = 0; b < _BENCH_FORMATS; b++)
+		{
+			for (p = 0; p < sizeof(_benchPitches) /
+				     sizeof(_benchPitches[0]); p++)
+			{
+				for (s = 0; s < sizeof(_benchSources) /
+					     sizeof(_benchSources[0]); s++)
+				{
+					_benchRun(ctx,
+						  _benchLayouts[layout].channels,
+						  buffers[b], _benchFormats[b].name,
+						  _benchPitches[p],
+						  _benchSources[s], frames, out);
+				}
+			}
+		}
+
+		alDeleteBuffers(_BENCH_FORMATS, buffers);
+
+		alcMakeContextCurrent(0);
+		alcDestroyContext(ctx);
+		alcCloseDevice(dev);
+	}
+
+	sprintf((char *)data, "%s/.openal-alsa", home);
+	unlink((char *)data);
+	sprintf((char *)data, "%s/.openal-speakers", home);
+	unlink((char *)data);
+	rmdir(home);
+
+	free(data);
+	free(out);
+
+	return 0;
+}
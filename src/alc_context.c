@@ -17,10 +17,20 @@
  *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
-#include <sys/time.h>
+#define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <ansidecl.h>
 
+#include <AL/alext.h>
+
 #include "al_listener.h"
 #include "al_source.h"
 #include "alc_context.h"
@@ -28,72 +38,317 @@
 
 AL_context *_alcCurrentContext = 0;
 
-static ALCvoid *_alcThread(ALCcontext *cc)
+/* The pcm the mixer thread feeds at index i, in software mode only
+   the device pcm, otherwise the pcms of the playing sources */
+static snd_pcm_t *_alcPollHandle(AL_context *ctx, ALuint i)
 {
-	AL_context *ctx = cc;
 	ALCdevice *dev = ctx->device;
-	ALuint i;
-	struct timeval tv;
-	struct timespec ts;
-/*	long ns = 1000000000 / dev->refresh;*/
-	int ns = 1000000000 / dev->refresh;
+	AL_source *src;
+
+	if (dev->mixer)
+	{
+		return i ? 0 : dev->handle;
+	}
+
+	/* A stopped source's pcm may be handed on to another */
+	if (!(src = ctx->mix_sources[i]) || src->state != AL_PLAYING ||
+	    !src->handle)
+	{
+		return 0;
+	}
+
+	return src->handle;
+}
 
+/* How many indices _alcPollHandle has */
+#define _alcPollHandles(ctx) \
+	((ctx)->device->mixer ? 1 : (ctx)->mix_source_slots)
 
-	pthread_mutex_lock(&ctx->mutex);
-	do
+/* Collect the poll descriptors of the wake pipe and of every pcm the
+   mixer thread feeds.  Returns the number of descriptors. */
+static int _alcPollDescriptors(AL_context *ctx, struct pollfd **pfd,
+			       int *size)
+{
+	int count = 1;
+	ALuint i;
+
+	for (i = 0; i < _alcPollHandles(ctx); i++)
 	{
-		gettimeofday(&tv, 0);
+		snd_pcm_t *handle;
+		int n;
 
-		for (i = 0; i < dev->subdevs; i++)
+		if (!(handle = _alcPollHandle(ctx, i)))
 		{
-			AL_source *src;
+			continue;
+		}
 
-			if ((src = ctx->sources[i]))
+		if ((n = snd_pcm_poll_descriptors_count(handle)) <= 0)
+		{
+			continue;
+		}
+
+		if (count + n > *size)
+		{
+			struct pollfd *p;
+
+			if (!(p = realloc(*pfd, (count + n) * sizeof(struct pollfd))))
 			{
-				_alProcessSource(src);
+				break;
 			}
+
+			*pfd = p;
+			*size = count + n;
+		}
+
+		count += snd_pcm_poll_descriptors(handle, *pfd + count, n);
+	}
+
+	(*pfd)->fd = ctx->wake[0];
+	(*pfd)->events = POLLIN;
+
+	return count;
+}
+
+/* Sleep until a pcm wants more frames or the context is woken */
+static ALCboolean _alcWait(AL_context *ctx, struct pollfd *pfd, int count)
+{
+	ALCdevice *dev = ctx->device;
+	unsigned short revents;
+	ALCboolean ready;
+	char buf[16];
+	int timeout;
+	ALuint i;
+	int k, n;
+
+	/* Draining and not yet started pcms don't report through poll,
+	   so wake at least once per buffer while any are open. */
+	timeout = -1;
+
+	if (count > 1)
+	{
+		timeout = dev->latency * 1000 / dev->freq + 1;
+	}
+
+	if ((n = poll(pfd, count, timeout)) <= 0)
+	{
+		return n ? ALC_FALSE : ALC_TRUE;
+	}
+
+	if (pfd->revents & POLLIN)
+	{
+		while (read(ctx->wake[0], buf, sizeof(buf)) > 0);
+
+		return ALC_TRUE;
+	}
+
+	/* Plugins such as dmix signal on descriptors of their own, each
+	   pcm has to translate what its descriptors said */
+	ready = ALC_FALSE;
+
+	for (i = 0, k = 1; i < _alcPollHandles(ctx) && k < count; i++)
+	{
+		snd_pcm_t *handle;
+
+		if (!(handle = _alcPollHandle(ctx, i)) ||
+		    (n = snd_pcm_poll_descriptors_count(handle)) <= 0)
+		{
+			continue;
 		}
 
-		ts.tv_sec = tv.tv_sec;
-		if ((ts.tv_nsec = (tv.tv_usec * 1000) + ns) >= 1000000000)
+		if (!snd_pcm_poll_descriptors_revents(handle, pfd + k, n,
+						      &revents) &&
+		    (revents & (POLLOUT | POLLERR)))
 		{
-			ts.tv_sec += 1;
-			ts.tv_nsec -= 1000000000;
+			ready = ALC_TRUE;
 		}
+
+		k += n;
 	}
-	while (pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &ts));
-	pthread_mutex_unlock(&ctx->mutex);
 
+	return ready;
+}
+
+static ALCvoid *_alcThread(ALCcontext *cc)
+{
+	AL_context *ctx = cc;
+	struct pollfd *pfd;
+	int size = 1;
+	int count;
+
+	if (!(pfd = malloc(size * sizeof(struct pollfd))))
+	{
+		return 0;
+	}
+
+	while (!__atomic_load_n(&ctx->quit, __ATOMIC_ACQUIRE))
+	{
+		_alProcessContext(ctx);
+
+		do
+		{
+			count = _alcPollDescriptors(ctx, &pfd, &size);
+		}
+		while (!_alcWait(ctx, pfd, count));
+	}
+
+	free(pfd);
 
 	return 0;
 }
 
+/* Each of these needs privileges the process may not have, whatever
+   fails is left as it was and the device reports what took effect. */
+static ALCvoid _alcSetThreadMode(AL_context *ctx)
+{
+	ALCdevice *dev = ctx->device;
+	int err;
+
+	dev->thread_priority = 0;
+	dev->thread_cpu = -1;
+
+	if (dev->priority > 0)
+	{
+		struct sched_param param;
+		int min = sched_get_priority_min(SCHED_FIFO);
+		int max = sched_get_priority_max(SCHED_FIFO);
+
+		param.sched_priority = dev->priority;
+
+		if (param.sched_priority < min)
+		{
+			param.sched_priority = min;
+		}
+		else if (param.sched_priority > max)
+		{
+			param.sched_priority = max;
+		}
+
+		if ((err = pthread_setschedparam(ctx->thread, SCHED_FIFO, &param)))
+		{
+			fprintf(stderr, "openal: can't use SCHED_FIFO: %s\n",
+				strerror(err));
+		}
+		else
+		{
+			dev->thread_priority = param.sched_priority;
+		}
+	}
+
+	if (dev->cpu >= 0)
+	{
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(dev->cpu, &set);
+
+		if ((err = pthread_setaffinity_np(ctx->thread, sizeof(set), &set)))
+		{
+			fprintf(stderr, "openal: can't pin mixer to cpu %d: %s\n",
+				dev->cpu, strerror(err));
+		}
+		else
+		{
+			dev->thread_cpu = dev->cpu;
+		}
+	}
+
+	if (dev->lock && !dev->thread_lock)
+	{
+		if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		{
+			fprintf(stderr, "openal: can't lock memory: %s\n",
+				strerror(errno));
+		}
+		else
+		{
+			dev->thread_lock = ALC_TRUE;
+		}
+	}
+}
+
+ALvoid _alSendContext(AL_context *ctx)
+{
+	AL_command cmd;
+
+	cmd.type = _AL_CMD_CONTEXT;
+	cmd.source = 0;
+	cmd.u.context.doppler_factor = ctx->doppler_factor;
+	cmd.u.context.doppler_velocity = ctx->doppler_velocity;
+	cmd.u.context.distance_func = ctx->distance_func;
+
+	_alSendCommand(ctx, &cmd);
+}
+
+ALvoid _alcWakeContext(AL_context *ctx)
+{
+	if (ctx->thread)
+	{
+		write(ctx->wake[1], "", 1);
+	}
+}
+
 static ALCboolean _alcCreateContext(AL_context *ctx)
 {
 	ALCdevice *dev = ctx->device;
-	ALuint i;
+	ALuint i, line;
 
 	pthread_mutex_init(&ctx->mutex, 0);
 
-	if (!(ctx->sources = malloc(dev->subdevs * sizeof(AL_source*))))
+	if (!(ctx->commands = _alCreateCommands()))
+	{
+		return AL_FALSE;
+	}
+
+	if (!_alcSetBuffering(dev))
 	{
 		return AL_FALSE;
 	}
 
-	for (i = 0; i < dev->subdevs; i++)
+	/* Stage lines have room for the interpolator's extra frames */
+	line = _alMixAlign(dev->buffer_size);
+	ctx->stage_size = line + _AL_MIX_ALIGN;
+
+	if (posix_memalign((void **)&ctx->mix, _AL_MIX_ALIGN * sizeof(ALfloat),
+			   ((dev->channels + _AL_MAX_LOAD) * line +
+			    _AL_MAX_LOAD * ctx->stage_size) * sizeof(ALfloat) +
+			   _AL_MAX_LOAD * ctx->stage_size * sizeof(ALshort)))
 	{
-		ctx->sources[i] = 0;
+		ctx->mix = 0;
+		return AL_FALSE;
 	}
 
-	if (!dev->sync)
+	for (i = 0; i < dev->channels; i++)
 	{
+		ctx->bus[i] = ctx->mix + i * line;
+	}
 
-		pthread_cond_init(&ctx->cond, 0);
+	for (i = 0; i < _AL_MAX_LOAD; i++)
+	{
+		ctx->voice[i] = ctx->mix + (dev->channels + i) * line;
+		ctx->stage[i] = ctx->mix + (dev->channels + _AL_MAX_LOAD) * line +
+				i * ctx->stage_size;
+	}
+
+	ctx->pull = (ALshort *)(ctx->mix + (dev->channels + _AL_MAX_LOAD) * line +
+				_AL_MAX_LOAD * ctx->stage_size);
+
+	if (!dev->sync && !dev->loopback)
+	{
+		if (pipe(ctx->wake))
+		{
+			ctx->wake[0] = -1;
+			return AL_FALSE;
+		}
+
+		fcntl(ctx->wake[0], F_SETFL, O_NONBLOCK);
+		fcntl(ctx->wake[1], F_SETFL, O_NONBLOCK);
 
 		if (pthread_create(&ctx->thread, 0, _alcThread, ctx))
 		{
 			return AL_FALSE;
 		}
+
+		_alcSetThreadMode(ctx);
 	}
 
 	return ALC_TRUE;
@@ -106,23 +361,42 @@ static ALCvoid _alcDestroyContext(AL_context *ctx)
 
 	dev = ctx->device;
 
-	for (i = 0; i < dev->subdevs; i++)
+	if (ctx->thread)
 	{
-		AL_source *src;
+		__atomic_store_n(&ctx->quit, AL_TRUE, __ATOMIC_RELEASE);
 
-		if ((src = ctx->sources[i]))
-		{
-			_alDeleteSource(src);
-		}
+		_alcWakeContext(ctx);
+
+		pthread_join(ctx->thread, 0);
+
+		ctx->thread = 0;
 	}
 
-	if (ctx->thread)
+	if (ctx->wake[0] >= 0)
 	{
-		pthread_cond_signal(&ctx->cond);
+		close(ctx->wake[0]);
+		close(ctx->wake[1]);
+	}
 
-		pthread_join(ctx->thread, 0);
+	/* With the thread gone the commands are drained here */
+	if (ctx->commands)
+	{
+		for (i = 0; i < ctx->source_slots; i++)
+		{
+			AL_source *src;
+
+			if ((src = ctx->sources[i]))
+			{
+				_alDeleteSource(src);
+			}
+		}
+
+		_alProcessCommands(ctx);
+	}
 
-		pthread_cond_destroy(&ctx->cond);
+	if (dev->handle)
+	{
+		snd_pcm_drop(dev->handle);
 	}
 
 	if (ctx->sources)
@@ -130,6 +404,26 @@ static ALCvoid _alcDestroyContext(AL_context *ctx)
 		free(ctx->sources);
 	}
 
+	if (ctx->generations)
+	{
+		free(ctx->generations);
+	}
+
+	if (ctx->mix_sources)
+	{
+		free(ctx->mix_sources);
+	}
+
+	if (ctx->commands)
+	{
+		free(ctx->commands);
+	}
+
+	if (ctx->mix)
+	{
+		free(ctx->mix);
+	}
+
 	pthread_mutex_destroy(&ctx->mutex);
 
 	free(ctx);
@@ -175,6 +469,30 @@ ALCcontext *alcCreateContext(ALCdevice *dev, ALCint *attrlist)
 		case ALC_SYNC:
 			dev->sync = *(attrlist++) ? AL_TRUE: AL_FALSE;
 			break;
+		case ALC_REALTIME_PRIORITY_EXT:
+			dev->priority = *(attrlist++);
+			break;
+		case ALC_CPU_AFFINITY_EXT:
+			dev->cpu = *(attrlist++);
+			break;
+		case ALC_MEMORY_LOCK_EXT:
+			dev->lock = *(attrlist++) ? ALC_TRUE : ALC_FALSE;
+			break;
+		case ALC_BUFFER_SIZE_EXT:
+			if ((value = *(attrlist++)) > 0)
+			{
+				dev->buffer_frames = value;
+			}
+			break;
+		case ALC_PERIODS_EXT:
+			if ((value = *(attrlist++)) > 1)
+			{
+				dev->buffer_periods = value;
+			}
+			break;
+		case ALC_ADAPTIVE_LATENCY_EXT:
+			dev->adaptive = *(attrlist++) ? ALC_TRUE : ALC_FALSE;
+			break;
 		default:
 			attrlist = 0;
 			break;
@@ -187,9 +505,19 @@ ALCcontext *alcCreateContext(ALCdevice *dev, ALCint *attrlist)
 	}
 
 	ctx->sources = 0;
+	ctx->generations = 0;
+	ctx->source_slots = 0;
+	ctx->free_source = 0;
+	ctx->mix_sources = 0;
+	ctx->mix_source_slots = 0;
+	ctx->commands = 0;
+	ctx->mix = 0;
 	ctx->thread = 0;
+	ctx->wake[0] = -1;
+	ctx->quit = AL_FALSE;
 
 	_alcLoadSpeakers(ctx->speakers);
+	_alcRouteSpeakers(ctx->speakers, dev->channels, ctx->route);
 	_alInitListener(&ctx->listener, ctx->speakers);
 
 	ctx->doppler_factor = 1.0f;
@@ -197,6 +525,11 @@ ALCcontext *alcCreateContext(ALCdevice *dev, ALCint *attrlist)
 	ctx->distance_model = AL_INVERSE_DISTANCE;
 	ctx->distance_func = _alDistanceInverse;
 
+	ctx->mix_listener = ctx->listener;
+	ctx->mix_doppler_factor = ctx->doppler_factor;
+	ctx->mix_doppler_velocity = ctx->doppler_velocity;
+	ctx->mix_distance_func = ctx->distance_func;
+
 	if (_alcCreateContext(ctx))
 		return ctx;
 
@@ -260,8 +593,6 @@ ALCvoid alcSuspendContext(ALCcontext *cc ATTRIBUTE_UNUSED)
 ALCvoid *alcProcessContext(ALCcontext *cc)
 {
 	AL_context *ctx;
-	ALCdevice *dev;
-	ALuint i;
 
 	if (!(ctx = cc))
 	{
@@ -276,19 +607,44 @@ ALCvoid *alcProcessContext(ALCcontext *cc)
 
 	_alcLockContext(ctx);
 
-	dev = ctx->device;
+	_alProcessContext(ctx);
 
-	for (i = 0; i < dev->subdevs; i++)
+	_alcUnlockContext(ctx);
+
+	return cc;
+}
+
+ALCvoid alcRenderContext_EXT(ALCcontext *cc, ALshort *data, ALCsizei frames)
+{
+	AL_context *ctx;
+
+	if (!(ctx = cc))
 	{
-		AL_source *src;
+		_alcSetError(ALC_INVALID_CONTEXT);
+		return;
+	}
 
-		if ((src = ctx->sources[i]))
-		{
-			_alProcessSource(src);
-		}
+	if (!ctx->device->loopback)
+	{
+		_alcSetError(ALC_INVALID_DEVICE);
+		return;
 	}
 
-	_alcUnlockContext(ctx);
+	/* ALCsizei is unsigned here, a negative count comes in huge */
+	if ((ALCint)frames < 0 || (frames && !data))
+	{
+		_alcSetError(ALC_INVALID_VALUE);
+		return;
+	}
 
-	return cc;
+	if (!frames)
+	{
+		return;
+	}
+
+	_alcLockContext(ctx);
+
+	_alRenderContext(ctx, data, frames);
+
+	_alcUnlockContext(ctx);
 }
@@ -30,23 +30,55 @@
 #include "alc_device.h"
 #include "al_source.h"
 #include "al_listener.h"
+#include "al_mixer.h"
+#include "al_command.h"
 
 typedef struct _AL_context
 {
 	ALCdevice *device;
+
+	/* Sources by slot and the generation of each slot, grown as more
+	   are made.  There is no free slot below free_source. */
 	AL_source **sources;
+	ALuint *generations;
+	ALuint source_slots;
+	ALuint free_source;
+
+	/* Float mix bus, one line per speaker, the stage lines the
+	   buffer samples are fetched into and the voice lines they are
+	   resampled into before panning. */
+	ALfloat *mix;
+	ALfloat *bus[_ALC_NUM_SPEAKERS];
+	ALfloat *stage[_AL_MAX_LOAD];
+	ALfloat *voice[_AL_MAX_LOAD];
+	ALuint stage_size;
+	ALshort *pull;		/* stage_size frames from a callback */
 
+	/* The mixer thread sleeps in poll on the pcms and on this pipe */
 	pthread_t thread;
 	pthread_mutex_t mutex;
-	pthread_cond_t cond;
+	int wake[2];
+	ALboolean quit;
 
 	AL_listener listener;
 	AL_speaker speakers[_ALC_NUM_SPEAKERS];
+	ALfloat route[_ALC_NUM_SPEAKERS][_ALC_NUM_SPEAKERS];
 
 	ALfloat doppler_factor;
 	ALfloat doppler_velocity;
 	ALenum distance_model;
 	ALfloat (*distance_func)(AL_source *, ALfloat);
+
+	/* The mixer's copy of the above and of the source table, only
+	   changed by commands from the API threads.  ctx->mutex is only
+	   taken by the API threads. */
+	AL_commands *commands;
+	AL_source **mix_sources;
+	ALuint mix_source_slots;
+	AL_listener mix_listener;
+	ALfloat mix_doppler_factor;
+	ALfloat mix_doppler_velocity;
+	ALfloat (*mix_distance_func)(AL_source *, ALfloat);
 }
 AL_context;
 
@@ -56,6 +88,10 @@ extern AL_context *_alcCurrentContext;
 #define _alcUnlockContext(ctx) pthread_mutex_unlock(&ctx->mutex)
 
 AL_source *_alFindSource(AL_context *, ALuint);
+ALvoid _alProcessContext(AL_context *);
+ALvoid _alRenderContext(AL_context *, ALshort *, ALuint);
+ALvoid _alcWakeContext(AL_context *);
+ALvoid _alSendContext(AL_context *);
 
 ALfloat _alDistanceInverse(AL_source *, ALfloat);
 
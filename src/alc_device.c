@@ -21,23 +21,34 @@
 #include <sys/fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ansidecl.h>
 #include <alsa/asoundlib.h>
 
+#include <AL/alc.h>
+#include <AL/alext.h>
+
 #include "alc_device.h"
 #include "alc_context.h"
 #include "alc_error.h"
+#include "al_mixer.h"
+#include "al_command.h"
 		    
 #define _ALC_DEF_FREQ 44100
 #define _ALC_NUM_PERIODS 2
 #define _ALC_BUFFER_SIZE 4096
 
+/* Adaptive buffering asks for periods this short and takes one off
+   the queue after this many milliseconds without an underrun */
+#define _ALC_ADAPTIVE_PERIOD 128
+#define _ALC_SETTLE_TIME 10000
+
 ALvoid _alcLoadConfig(struct _AL_device *dev)
 {
 	char *s, buf[1024];
 	FILE *fp;
 	ALuint i;
-	char par[16],val[16];
+	char par[16],val[64];
 
 
 	if (!(s = getenv("HOME")))
@@ -59,18 +70,19 @@ ALvoid _alcLoadConfig(struct _AL_device *dev)
 			*s = '\0';
 		}
 
-		if (sscanf(buf, "%s %s", par,val) == 2)
+		if (sscanf(buf, "%15s %63s", par,val) == 2)
 		{
 			if (strcmp(par,"device") == 0)
 			{
-				sprintf(dev->device,val);
+				snprintf(dev->device, sizeof(dev->device), "%s", val);
 /*				fprintf(stderr,"device : %s\n",dev->device);*/
 			}
 			else 
 			if (strcmp(par,"channels") == 0)
 			{
 				i = atoi(val);
-				dev->channels = i;
+				if (i > 0 && i <= _ALC_NUM_SPEAKERS)
+					dev->channels = i;
 /*				fprintf(stderr,"channels : %d\n",dev->channels);*/
 			}
 			else
@@ -80,6 +92,55 @@ ALvoid _alcLoadConfig(struct _AL_device *dev)
 				dev->subdevs = i;
 /*				fprintf(stderr,"devices : %d\n",dev->subdevs);*/
 			}
+			else
+			if (strcmp(par,"resampler") == 0)
+			{
+				if (strcmp(val,"nearest") == 0)
+					dev->resampler = _AL_RESAMPLE_NEAREST;
+				else if (strcmp(val,"linear") == 0)
+					dev->resampler = _AL_RESAMPLE_LINEAR;
+				else if (strcmp(val,"cubic") == 0)
+					dev->resampler = _AL_RESAMPLE_CUBIC;
+			}
+			else
+			if (strcmp(par,"priority") == 0)
+			{
+				dev->priority = atoi(val);
+			}
+			else
+			if (strcmp(par,"cpu") == 0)
+			{
+				dev->cpu = atoi(val);
+			}
+			else
+			if (strcmp(par,"mlock") == 0)
+			{
+				dev->lock = strcmp(val,"yes") ? ALC_FALSE : ALC_TRUE;
+			}
+			else
+			if (strcmp(par,"buffer") == 0)
+			{
+				i = atoi(val);
+				if (i > 0)
+					dev->buffer_frames = i;
+			}
+			else
+			if (strcmp(par,"periods") == 0)
+			{
+				i = atoi(val);
+				if (i > 1)
+					dev->buffer_periods = i;
+			}
+			else
+			if (strcmp(par,"latency") == 0)
+			{
+				dev->adaptive = strcmp(val,"adaptive") ? ALC_FALSE : ALC_TRUE;
+			}
+			else
+			if (strcmp(par,"mixer") == 0)
+			{
+				dev->mixer = strcmp(val,"software") ? ALC_FALSE : ALC_TRUE;
+			}
 			
 		}
 	}
@@ -87,101 +148,370 @@ ALvoid _alcLoadConfig(struct _AL_device *dev)
 	fclose(fp);
 }
 
-
-ALCboolean _alcOpenSource(AL_source *src)
+/* Common hw setup for the device pcm and the per source pcms */
+static ALCboolean _alcSetHwParams(snd_pcm_t *handle, ALuint channels,
+				  ALuint *freq, ALuint *periods,
+				  snd_pcm_uframes_t *size,
+				  snd_pcm_uframes_t *period_size)
 {
 	snd_pcm_hw_params_t *hw_params;
-	snd_pcm_info_t *info;
-	snd_pcm_uframes_t size;
-	AL_context *ctx = src->context;
-	ALCdevice *dev = ctx->device;
 	int access_type = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	int err;
+	int dir;
+
+	snd_pcm_hw_params_alloca(&hw_params);
+
+	if (snd_pcm_hw_params_any(handle, hw_params))
+		return ALC_FALSE;
+
+	snd_pcm_hw_params_set_channels(handle, hw_params, channels);
+	if (channels > 2) access_type = SND_PCM_ACCESS_MMAP_COMPLEX;
 
-	if (dev->count < dev->subdevs)
+	if (snd_pcm_hw_params_set_access(handle, hw_params,
+					 access_type))
+		return ALC_FALSE;
+	if (snd_pcm_hw_params_set_format(handle, hw_params,
+					 SND_PCM_FORMAT_S16))
+		return ALC_FALSE;
+
+	if (snd_pcm_hw_params_set_rate_near(handle, hw_params,
+					    freq, 0))
+		return ALC_FALSE;
+
+	if (snd_pcm_hw_params_set_periods_near(handle, hw_params, periods, 0))
+		return ALC_FALSE;
+
+	if (snd_pcm_hw_params_set_buffer_size_near(handle, hw_params,
+						   size))
+		return ALC_FALSE;
+
+	if ((err = snd_pcm_hw_params(handle, hw_params))){
+		fprintf(stderr,"Unable to set hwparams: %s\n", snd_strerror(err));
+		return ALC_FALSE;
+	}
+
+	err = snd_pcm_hw_params_get_period_size(hw_params, period_size, &dir);
+	if (err < 0) {
+		fprintf(stderr,"Unable to determine current swparams for playback: %s\n", snd_strerror(err));
+		return ALC_FALSE;
+	}
+/*	fprintf(stderr,"period_size : %d\n",*period_size);*/
+
+	return ALC_TRUE;
+}
+
+/* What to ask of a pcm.  Adaptive buffering wants short periods so
+   the queue can be kept anywhere between two of them and the whole
+   buffer. */
+static ALCvoid _alcAskBuffering(ALCdevice *dev, ALuint *periods,
+				snd_pcm_uframes_t *size)
+{
+	*size = dev->buffer_frames;
+	*periods = dev->buffer_periods;
+
+	if (dev->adaptive)
 	{
-		if (snd_pcm_open(&src->handle, dev->device, SND_PCM_STREAM_PLAYBACK,
-				 SND_PCM_NONBLOCK))
-			return ALC_FALSE;
-	
-		snd_pcm_hw_params_alloca(&hw_params);
-	
-		if (snd_pcm_hw_params_any(src->handle, hw_params))
-			return ALC_FALSE;
-	
-		src->channels = dev->channels;
-		snd_pcm_hw_params_set_channels(src->handle, hw_params, src->channels);
-		if (src->channels > 2) access_type = SND_PCM_ACCESS_MMAP_COMPLEX;
-	
-		if (snd_pcm_hw_params_set_access(src->handle, hw_params,
-						 access_type))
-			return ALC_FALSE;
-		if (snd_pcm_hw_params_set_format(src->handle, hw_params,
-						 SND_PCM_FORMAT_S16))
-			return ALC_FALSE;
-	
-		src->freq = dev->freq;
-		if (snd_pcm_hw_params_set_rate_near(src->handle, hw_params,
-						    &src->freq, 0))
-			return ALC_FALSE;
-	
-		src->periods = _ALC_NUM_PERIODS;
-		if (snd_pcm_hw_params_set_periods_near(src->handle, hw_params, &src->periods,0))
-			return ALC_FALSE;
-	
-	
-		size = _ALC_BUFFER_SIZE;
-		if (snd_pcm_hw_params_set_buffer_size_near(src->handle, hw_params,
-							   &size))
+		*periods = dev->buffer_frames / _ALC_ADAPTIVE_PERIOD;
+
+		if (*periods < dev->buffer_periods)
+		{
+			*periods = dev->buffer_periods;
+		}
+	}
+}
+
+/* Set up the buffering asked for in the config and the context
+   attributes.  In software mode on the device pcm, otherwise on a
+   spare pcm to learn what the source pcms are going to get. */
+ALCboolean _alcSetBuffering(ALCdevice *dev)
+{
+	snd_pcm_t *handle = dev->handle;
+	ALuint freq = dev->freq;
+
+	if (dev->loopback)
+	{
+		/* No pcm, the caller's buffer is mixed a buffer at a time */
+		dev->periods = dev->buffer_periods;
+		dev->buffer_size = dev->buffer_frames;
+		dev->period_size = dev->buffer_size / dev->periods;
+	}
+	else
+	{
+		if (!handle && snd_pcm_open(&handle, dev->device,
+					    SND_PCM_STREAM_PLAYBACK,
+					    SND_PCM_NONBLOCK))
 			return ALC_FALSE;
-	
-		
-/*		fprintf(stderr,"device: %s\n",dev->device);	
-		fprintf(stderr,"channels : %d\n",src->channels);
-		fprintf(stderr,"refresh : %d\n",dev->refresh);
-		fprintf(stderr,"buffer_size : %d\n",size);
-		fprintf(stderr,"freq: %d\n",src->freq);
-		fprintf(stderr,"periods : %d\n",src->periods);*/
-	
-		int err;
-		int dir;
-	
-		if ((err = snd_pcm_hw_params(src->handle, hw_params))){
-			fprintf(stderr,"Unable to set hwparams: %s\n", snd_strerror(err));
+
+		_alcAskBuffering(dev, &dev->periods, &dev->buffer_size);
+
+		if (!_alcSetHwParams(handle, dev->channels, &freq,
+				     &dev->periods, &dev->buffer_size,
+				     &dev->period_size))
+		{
+			if (handle != dev->handle) snd_pcm_close(handle);
 			return ALC_FALSE;
 		}
-	
-	
-		err = snd_pcm_hw_params_get_period_size(hw_params,&src->period_size,&dir);
-		if (err < 0) {
-			fprintf(stderr,"Unable to determine current swparams for playback: %s\n", snd_strerror(err));
-			return ALC_FALSE;
+
+		if (handle != dev->handle) snd_pcm_close(handle);
+
+		if (dev->mixer)
+		{
+			dev->freq = freq;
 		}
-/*		fprintf(stderr,"period_size : %d\n",src->period_size);*/
-	
-	
-		snd_pcm_info_alloca(&info);
-	
-		if (snd_pcm_info(src->handle, info))
-			return ALC_FALSE;
-		
-	
-		src->subdev = dev->subdevs - ++dev->count;
-		
-		return ALC_TRUE;
 	}
-	else 
+
+	dev->max_latency = dev->buffer_size;
+	dev->min_latency = 2 * dev->period_size;
+
+	if (dev->min_latency > dev->max_latency)
+	{
+		dev->min_latency = dev->max_latency;
+	}
+
+	dev->latency = dev->adaptive ? dev->min_latency : dev->max_latency;
+	dev->wakeup = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &dev->settled);
+
+	return ALC_TRUE;
+}
+
+/* The frames of a pcm of size that have to stay empty to keep only
+   the latency queued.  The pcm is told to wake the mixer once the
+   queue is a period below that. */
+snd_pcm_sframes_t _alcHeadroom(ALCdevice *dev, snd_pcm_t *handle,
+			       snd_pcm_uframes_t size,
+			       snd_pcm_uframes_t period_size,
+			       snd_pcm_uframes_t *wakeup)
+{
+	snd_pcm_sw_params_t *sw_params;
+	snd_pcm_uframes_t latency = dev->latency;
+	snd_pcm_uframes_t avail_min;
+
+	if (latency > size)
+	{
+		latency = size;
+	}
+
+	avail_min = size - latency + period_size;
+
+	if (avail_min > size)
+	{
+		avail_min = size;
+	}
+
+	if (avail_min != *wakeup)
+	{
+		snd_pcm_sw_params_alloca(&sw_params);
+
+		if (!snd_pcm_sw_params_current(handle, sw_params) &&
+		    !snd_pcm_sw_params_set_avail_min(handle, sw_params,
+						     avail_min) &&
+		    !snd_pcm_sw_params(handle, sw_params))
+		{
+			*wakeup = avail_min;
+		}
+	}
+
+	return size - latency;
+}
+
+/* Adaptive buffering: an underrun doubles the queue at once, every
+   _ALC_SETTLE_TIME without one takes a period off it again */
+ALCvoid _alcDeviceXrun(ALCdevice *dev)
+{
+	ALuint latency = dev->latency * 2;
+
+	__atomic_fetch_add(&dev->counters.xruns, 1, __ATOMIC_RELAXED);
+
+	if (!dev->adaptive)
+	{
+		return;
+	}
+
+	if (latency > dev->max_latency)
+	{
+		latency = dev->max_latency;
+	}
+
+	__atomic_store_n(&dev->latency, latency, __ATOMIC_RELAXED);
+
+	clock_gettime(CLOCK_MONOTONIC, &dev->settled);
+}
+
+ALCvoid _alcDeviceSettle(ALCdevice *dev)
+{
+	struct timespec now;
+	ALuint latency;
+	long ms;
+
+	if (!dev->adaptive || dev->latency <= dev->min_latency)
+	{
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	ms = (now.tv_sec - dev->settled.tv_sec) * 1000 +
+	     (now.tv_nsec - dev->settled.tv_nsec) / 1000000;
+
+	if (ms < _ALC_SETTLE_TIME)
+	{
+		return;
+	}
+
+	latency = dev->latency - dev->period_size;
+
+	if (latency < dev->min_latency)
+	{
+		latency = dev->min_latency;
+	}
+
+	__atomic_store_n(&dev->latency, latency, __ATOMIC_RELAXED);
+
+	dev->settled = now;
+}
+
+ALCvoid _alcInitSource(AL_source *src)
+{
+	AL_context *ctx = src->context;
+	ALCdevice *dev = ctx->device;
+
+	src->channels = dev->channels;
+	src->freq = dev->freq;
+
+	if (dev->mixer)
+	{
+		/* Mixed in software into the device pcm, no voice to open */
+		src->periods = dev->periods;
+		src->buffer_size = dev->buffer_size;
+		src->period_size = dev->period_size;
+	}
+}
+
+/* Open a pcm into the command that hands it to src */
+static ALCboolean _alcOpenPcm(AL_source *src, AL_command *cmd)
+{
+	snd_pcm_info_t *info;
+	AL_context *ctx = src->context;
+	ALCdevice *dev = ctx->device;
+	snd_pcm_t *handle;
+
+	if (snd_pcm_open(&handle, dev->device, SND_PCM_STREAM_PLAYBACK,
+			 SND_PCM_NONBLOCK))
+	{
+		return ALC_FALSE;
+	}
+
+	cmd->u.voice.freq = dev->freq;
+	_alcAskBuffering(dev, &cmd->u.voice.periods,
+			 &cmd->u.voice.buffer_size);
+
+	snd_pcm_info_alloca(&info);
+
+	if (!_alcSetHwParams(handle, src->channels, &cmd->u.voice.freq,
+			     &cmd->u.voice.periods, &cmd->u.voice.buffer_size,
+			     &cmd->u.voice.period_size) ||
+	    snd_pcm_info(handle, info))
 	{
+		snd_pcm_close(handle);
 		return ALC_FALSE;
 	}
-		
+
+	cmd->u.voice.handle = handle;
+
+	return ALC_TRUE;
 }
 
-ALCvoid _alcCloseSource(AL_source *src)
+/* Called by the API, with the context locked, before a source plays.
+   Once the device has no more pcms the source takes over the pcm of
+   one the API has stopped.  The mixer moves it after the command that
+   stops that source, so neither side waits for the other. */
+ALCboolean _alcOpenVoice(AL_source *src)
 {
 	AL_context *ctx = src->context;
 	ALCdevice *dev = ctx->device;
+	AL_source *idle = 0;
+	AL_command cmd;
+	ALuint i;
+
+	if (dev->mixer || src->voice)
+	{
+		return ALC_TRUE;
+	}
+
+	cmd.type = _AL_CMD_SOURCE_VOICE;
+	cmd.source = src;
+	cmd.u.voice.from = 0;
+
+	if (dev->count < dev->subdevs && _alcOpenPcm(src, &cmd))
+	{
+		dev->count++;
+	}
+	else
+	{
+		for (i = 0; i < ctx->source_slots; i++)
+		{
+			ALenum state;
+
+			if (!(idle = ctx->sources[i]) || !idle->voice)
+			{
+				continue;
+			}
 
-	dev->count--;
+			state = (ALenum)(ALuint)__atomic_load_n(&idle->status,
+							       __ATOMIC_ACQUIRE);
+
+			if (state == AL_INITIAL || state == AL_STOPPED)
+			{
+				break;
+			}
+		}
+
+		if (i == ctx->source_slots)
+		{
+			return ALC_FALSE;
+		}
+
+		idle->voice = ALC_FALSE;
+		cmd.u.voice.from = idle;
+	}
+
+	src->voice = ALC_TRUE;
+	_alSendCommand(ctx, &cmd);
+
+	return ALC_TRUE;
+}
+
+/* Mixer side of _alcOpenVoice */
+ALCvoid _alcTakeVoice(AL_source *src, AL_command *cmd)
+{
+	AL_source *from;
+
+	if ((from = cmd->u.voice.from))
+	{
+		src->handle = from->handle;
+		src->freq = from->freq;
+		src->periods = from->periods;
+		src->buffer_size = from->buffer_size;
+		src->period_size = from->period_size;
+		src->wakeup = from->wakeup;
+
+		from->handle = 0;
+	}
+	else
+	{
+		src->handle = cmd->u.voice.handle;
+		src->freq = cmd->u.voice.freq;
+		src->periods = cmd->u.voice.periods;
+		src->buffer_size = cmd->u.voice.buffer_size;
+		src->period_size = cmd->u.voice.period_size;
+		src->wakeup = 0;
+	}
+}
+
+ALCvoid _alcCloseSource(AL_source *src)
+{
 	if (src->handle) snd_pcm_close(src->handle);
 }
 
@@ -189,11 +519,7 @@ static ALCboolean _alcOpenDevice(ALCdevice *dev)
 {
 	snd_pcm_info_t *pcm_info;
 	snd_pcm_t	*handle;
-	snd_pcm_hw_params_t *hw_params;
-	snd_pcm_uframes_t size;
 	ALuint freq;
-	ALuint periods;
-	int access_type = SND_PCM_ACCESS_MMAP_INTERLEAVED;
 
 	snd_pcm_info_alloca(&pcm_info);
 	
@@ -201,43 +527,32 @@ static ALCboolean _alcOpenDevice(ALCdevice *dev)
 	if (snd_pcm_open(&handle, dev->device, SND_PCM_STREAM_PLAYBACK,
 			 SND_PCM_NONBLOCK))
 		return ALC_FALSE;
-	snd_pcm_hw_params_alloca(&hw_params);
-
-	if (snd_pcm_hw_params_any(handle, hw_params))
-		return ALC_FALSE;
-	snd_pcm_hw_params_set_channels(handle, hw_params, dev->channels);
-	if (dev->channels > 2) access_type = SND_PCM_ACCESS_MMAP_COMPLEX;
-				
-	if (snd_pcm_hw_params_set_access(handle, hw_params,
-					 access_type))
-		return ALC_FALSE;
-	
-	if (snd_pcm_hw_params_set_format(handle, hw_params,
-					 SND_PCM_FORMAT_S16))
-		return ALC_FALSE;
 
 	freq = dev->freq;
-	if (snd_pcm_hw_params_set_rate_near(handle, hw_params,
-						&freq, 0))
-		return ALC_FALSE;
-	
-	periods = _ALC_NUM_PERIODS;
-	if (snd_pcm_hw_params_set_periods_near(handle, hw_params, &periods,0))
-		return ALC_FALSE;
+	_alcAskBuffering(dev, &dev->periods, &dev->buffer_size);
 
-	size = _ALC_BUFFER_SIZE;
-	if (snd_pcm_hw_params_set_buffer_size_near(handle, hw_params,
-					   &size))
+	if (!_alcSetHwParams(handle, dev->channels, &freq, &dev->periods,
+			     &dev->buffer_size, &dev->period_size))
+	{
+		snd_pcm_close(handle);
 		return ALC_FALSE;
+	}
 
-	dev->refresh = (ALint)((float)freq * (float)periods / (float)size * 2.0);
-
-	if (snd_pcm_hw_params(handle, hw_params))
-		return ALC_FALSE;
+	dev->refresh = (ALint)((float)freq * (float)dev->periods /
+			       (float)dev->buffer_size * 2.0);
 
+	if (dev->mixer)
+	{
+		/* Software mixing keeps this pcm as the single output,
+		   it is set up again by _alcSetBuffering with the context
+		   attributes. */
+		dev->handle = handle;
+		return ALC_TRUE;
+	}
 	
 	if (snd_pcm_info(handle, pcm_info)<0){
 		fprintf(stderr,"error on getting info\n");
+		snd_pcm_close(handle);
 		return ALC_FALSE;
 	}
 	
@@ -250,10 +565,60 @@ static ALCboolean _alcOpenDevice(ALCdevice *dev)
 
 static ALCvoid _alcCloseDevice(ALCdevice *dev)
 {
+	if (dev->handle) snd_pcm_close(dev->handle);
 	free(dev);
 }
 
-ALCdevice *alcOpenDevice(const ALubyte *spec ATTRIBUTE_UNUSED)
+/* A mix cycle that began at start is over */
+ALCvoid _alcDeviceCycle(ALCdevice *dev, const struct timespec *start)
+{
+	AL_counters *counters = &dev->counters;
+	struct timespec now;
+	ALuint us, bucket, wakeups;
+	long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	us = (now.tv_sec - start->tv_sec) * 1000000 +
+	     (now.tv_nsec - start->tv_nsec) / 1000;
+
+	bucket = us ? 32 - __builtin_clz(us) : 0;
+
+	if (bucket >= ALC_MIX_TIME_BUCKETS_EXT)
+	{
+		bucket = ALC_MIX_TIME_BUCKETS_EXT - 1;
+	}
+
+	__atomic_fetch_add(&counters->cycles[bucket], 1, __ATOMIC_RELAXED);
+
+	wakeups = __atomic_add_fetch(&counters->wakeups, 1, __ATOMIC_RELAXED);
+
+	ms = (now.tv_sec - counters->rate_start.tv_sec) * 1000 +
+	     (now.tv_nsec - counters->rate_start.tv_nsec) / 1000000;
+
+	if (ms >= 1000)
+	{
+		__atomic_store_n(&counters->wakeup_rate,
+				 (ALuint)((wakeups - counters->rate_wakeups) *
+					  1000LL / ms), __ATOMIC_RELAXED);
+
+		counters->rate_start = now;
+		counters->rate_wakeups = wakeups;
+	}
+}
+
+/* Sources mixed and passed over in one block */
+ALCvoid _alcDeviceVoices(ALCdevice *dev, ALuint mixed, ALuint skipped)
+{
+	AL_counters *counters = &dev->counters;
+
+	__atomic_store_n(&counters->voices, mixed, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->voices_mixed, mixed, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->voices_skipped, skipped,
+			   __ATOMIC_RELAXED);
+}
+
+static ALCdevice *_alcAllocDevice(ALvoid)
 {
 	ALCdevice *dev;
 
@@ -269,10 +634,46 @@ ALCdevice *alcOpenDevice(const ALubyte *spec ATTRIBUTE_UNUSED)
 	dev->refresh = 0; /* to calculate */
 	dev->subdevs = 0;
 	dev->channels = 2;
+	dev->mixer = ALC_FALSE;
+	dev->loopback = ALC_FALSE;
+	dev->resampler = _AL_RESAMPLE_LINEAR;
+	dev->priority = 0;
+	dev->cpu = -1;
+	dev->lock = ALC_FALSE;
+	dev->thread_priority = 0;
+	dev->thread_cpu = -1;
+	dev->thread_lock = ALC_FALSE;
+	dev->buffer_frames = _ALC_BUFFER_SIZE;
+	dev->buffer_periods = _ALC_NUM_PERIODS;
+	dev->adaptive = ALC_FALSE;
+	dev->latency = 0;
+	dev->min_latency = 0;
+	dev->max_latency = 0;
+	dev->handle = 0;
+	dev->periods = 0;
+	dev->buffer_size = 0;
+	dev->period_size = 0;
+	dev->wakeup = 0;
+	memset(&dev->counters, 0, sizeof(dev->counters));
+	clock_gettime(CLOCK_MONOTONIC, &dev->counters.rate_start);
 	sprintf(dev->device,"hw:0");
 	
 	_alcLoadConfig(dev);
 
+	_alMixerInit();
+
+	return dev;
+}
+
+ALCdevice *alcOpenDevice(const ALubyte *spec ATTRIBUTE_UNUSED)
+{
+	ALCdevice *dev;
+
+	if (!(dev = _alcAllocDevice()))
+	{
+		return 0;
+	}
+
 	if (_alcOpenDevice(dev))
 		return dev;
 
@@ -283,6 +684,27 @@ ALCdevice *alcOpenDevice(const ALubyte *spec ATTRIBUTE_UNUSED)
 	return 0;
 }
 
+/* A device without a pcm.  Nothing plays until alcRenderContext_EXT
+   asks for frames, which are then mixed as fast as the cpu goes. */
+ALCdevice *alcOpenLoopbackDevice_EXT(const ALubyte *spec ATTRIBUTE_UNUSED)
+{
+	ALCdevice *dev;
+
+	if (!(dev = _alcAllocDevice()))
+	{
+		return 0;
+	}
+
+	dev->loopback = ALC_TRUE;
+	dev->mixer = ALC_TRUE;
+	dev->adaptive = ALC_FALSE;
+
+	dev->refresh = (ALint)((float)dev->freq * (float)dev->buffer_periods /
+			       (float)dev->buffer_frames * 2.0);
+
+	return dev;
+}
+
 ALCvoid alcCloseDevice(ALCdevice *dev)
 {
 	if (dev)
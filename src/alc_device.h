@@ -20,26 +20,87 @@
 #ifndef _ALC_DEVICE_H_
 #define _ALC_DEVICE_H_
 
+#include <time.h>
 #include <alsa/asoundlib.h>
 
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <AL/alext.h>
 
 #include "al_source.h"
 
+struct _AL_command;
+
+/* Kept by the mixer, read by alcGetIntegerv without locking */
+typedef struct _AL_counters
+{
+	ALuint cycles[ALC_MIX_TIME_BUCKETS_EXT];
+	ALuint xruns;
+	ALuint wakeups;
+	ALuint wakeup_rate;
+	ALuint voices;
+	ALuint voices_mixed;
+	ALuint voices_skipped;
+
+	struct timespec rate_start;
+	ALuint rate_wakeups;
+}
+AL_counters;
+
 struct _AL_device
 {
-	char device[16];
-	ALuint subdevs;
+	char device[64];
+	ALuint subdevs;	/* pcms sources may open */
 /*	snd_ctl_t *ctl;*/
-	ALuint count;	
+	ALuint count;	/* pcms sources have open */
 	ALCboolean sync;
 	ALuint freq;
 	ALuint refresh;
 	ALuint channels;
+	ALuint resampler;
+
+	/* Mixer thread scheduling asked for and actually in effect */
+	ALint priority;
+	ALint cpu;
+	ALCboolean lock;
+	ALint thread_priority;
+	ALint thread_cpu;
+	ALCboolean thread_lock;
+
+	/* Buffering asked for, adaptive uses buffer_frames as the limit */
+	ALuint buffer_frames;
+	ALuint buffer_periods;
+	ALCboolean adaptive;
+
+	/* Frames kept queued in the pcms, only the mixer moves it */
+	ALuint latency;
+	ALuint min_latency;
+	ALuint max_latency;
+	struct timespec settled;
+
+	AL_counters counters;
+
+	/* Software mixer: every source is summed into this one pcm, or
+	   for a loopback device into the caller's buffer */
+	ALCboolean mixer;
+	ALCboolean loopback;
+	snd_pcm_t *handle;
+	ALuint periods;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t period_size;
+	snd_pcm_uframes_t wakeup;
 };
 
-ALCboolean _alcOpenSource(AL_source *);
+ALCboolean _alcSetBuffering(ALCdevice *);
+snd_pcm_sframes_t _alcHeadroom(ALCdevice *, snd_pcm_t *, snd_pcm_uframes_t,
+			       snd_pcm_uframes_t, snd_pcm_uframes_t *);
+ALCvoid _alcDeviceXrun(ALCdevice *);
+ALCvoid _alcDeviceSettle(ALCdevice *);
+ALCvoid _alcDeviceCycle(ALCdevice *, const struct timespec *);
+ALCvoid _alcDeviceVoices(ALCdevice *, ALuint, ALuint);
+ALCvoid _alcInitSource(AL_source *);
+ALCboolean _alcOpenVoice(AL_source *);
+ALCvoid _alcTakeVoice(AL_source *, struct _AL_command *);
 ALCvoid _alcCloseSource(AL_source *);
 
 #endif
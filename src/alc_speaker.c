@@ -89,3 +89,56 @@ ALvoid _alcLoadSpeakers(AL_speaker *speakers)
 
 	fclose(fp);
 }
+
+/* Where a speaker's channel goes on a device without it */
+static const struct
+{
+	ALint to[2];
+	ALfloat gain;
+}
+_alcSpeakerFold[_ALC_NUM_SPEAKERS] =
+{
+	{ { -1, -1 }, 0.0f },		/* Front Left */
+	{ {  0, -1 }, 1.0f },		/* Front Right, on a mono device */
+	{ {  0, -1 }, 1.0f },		/* Rear Left */
+	{ {  1, -1 }, 1.0f },		/* Rear Right */
+	{ {  0,  1 }, 0.70710678f },	/* Center */
+	{ { -1, -1 }, 0.0f },		/* LFE is dropped */
+	{ {  2, -1 }, 1.0f },		/* Side Left */
+	{ {  3, -1 }, 1.0f }		/* Side Right */
+};
+
+static ALvoid _alcRouteSpeaker(AL_speaker *speakers, ALuint channels,
+			       ALuint speaker, ALfloat gain, ALfloat *route)
+{
+	ALuint i;
+
+	if (speaker < channels && speakers[speaker].gain > 0.0f)
+	{
+		route[speaker] += gain * speakers[speaker].gain;
+		return;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if (_alcSpeakerFold[speaker].to[i] >= 0)
+		{
+			_alcRouteSpeaker(speakers, channels,
+					 _alcSpeakerFold[speaker].to[i],
+					 gain * _alcSpeakerFold[speaker].gain,
+					 route);
+		}
+	}
+}
+
+ALvoid _alcRouteSpeakers(AL_speaker *speakers, ALuint channels,
+			 ALfloat route[][_ALC_NUM_SPEAKERS])
+{
+	ALuint i;
+
+	for (i = 0; i < _ALC_NUM_SPEAKERS; i++)
+	{
+		memset(route[i], 0, _ALC_NUM_SPEAKERS * sizeof(ALfloat));
+		_alcRouteSpeaker(speakers, channels, i, 1.0f, route[i]);
+	}
+}
@@ -34,4 +34,9 @@ AL_speaker;
 
 ALvoid _alcLoadSpeakers(AL_speaker *);
 
+/* route[s][d] is how much of what is meant for speaker s the device's
+   speaker d plays, folding speakers the device lacks into others */
+ALvoid _alcRouteSpeakers(AL_speaker *, ALuint,
+			 ALfloat route[][_ALC_NUM_SPEAKERS]);
+
 #endif
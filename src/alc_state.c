@@ -19,6 +19,8 @@
 
 #include <ansidecl.h>
 
+#include <AL/alext.h>
+
 #include "alc_device.h"
 #include "alc_error.h"
 
@@ -67,6 +69,128 @@ ALCvoid alcGetIntegerv(ALCdevice *dev, ALCenum param,
 		data[6] = ALC_INVALID;
 		data[7] = 0;
 		break;
+	case ALC_REALTIME_PRIORITY_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->thread_priority;
+		break;
+	case ALC_CPU_AFFINITY_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->thread_cpu;
+		break;
+	case ALC_MEMORY_LOCK_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->thread_lock;
+		break;
+	case ALC_BUFFER_SIZE_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->buffer_size;
+		break;
+	case ALC_PERIODS_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->periods;
+		break;
+	case ALC_ADAPTIVE_LATENCY_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = dev->adaptive;
+		break;
+	case ALC_LATENCY_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		/* Moved by the mixer thread */
+		*data = __atomic_load_n(&dev->latency, __ATOMIC_RELAXED);
+		break;
+	case ALC_MIX_TIME_HISTOGRAM_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		{
+			ALuint i;
+
+			for (i = 0; i < ALC_MIX_TIME_BUCKETS_EXT &&
+				    (i + 1) * sizeof(ALCint) <= size; i++)
+			{
+				data[i] = __atomic_load_n(&dev->counters.cycles[i],
+							  __ATOMIC_RELAXED);
+			}
+		}
+		break;
+	case ALC_XRUNS_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.xruns, __ATOMIC_RELAXED);
+		break;
+	case ALC_WAKEUPS_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.wakeups, __ATOMIC_RELAXED);
+		break;
+	case ALC_WAKEUPS_PER_SECOND_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.wakeup_rate, __ATOMIC_RELAXED);
+		break;
+	case ALC_VOICES_MIXED_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.voices_mixed, __ATOMIC_RELAXED);
+		break;
+	case ALC_VOICES_SKIPPED_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.voices_skipped, __ATOMIC_RELAXED);
+		break;
+	case ALC_ACTIVE_VOICES_EXT:
+		if (!dev)
+		{
+			_alcSetError(ALC_INVALID_DEVICE);
+			break;
+		}
+		*data = __atomic_load_n(&dev->counters.voices, __ATOMIC_RELAXED);
+		break;
 	default:
 		_alcSetError(ALC_INVALID_ENUM);
 		break;
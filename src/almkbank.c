@@ -0,0 +1,240 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ *  Makes a sample bank for alutOpenBank_EXT out of wav files.
+ *
+ *	almkbank bank file.wav...
+ *
+ *  Each sound is named after its file without the directory and the
+ *  .wav suffix.  8 bit files are widened to 16 bit as alBufferData
+ *  would.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <AL/al.h>
+#include <AL/alut.h>
+
+#include "alut_bank.h"
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define swap16le(D) (D)
+#define swap32le(D) (D)
+#elif __BYTE_ORDER == __BIG_ENDIAN
+#define swap16le(D) ((u_int16_t)(((D)<<8) | ((D)>>8)))
+#define swap32le(D) ((((D)<<24) | (((D)<<8)&0x00FF0000) | (((D)>>8)&0x0000FF00) | ((D)>>24)))
+#else
+#error "Unknown endian"
+#endif
+
+typedef struct
+{
+	AL_bank_entry entry;
+	ALvoid *data;
+}
+AL_bank_sound;
+
+static int _bankCompare(const void *a, const void *b)
+{
+	return strcmp(((const AL_bank_sound *)a)->entry.name,
+		      ((const AL_bank_sound *)b)->entry.name);
+}
+
+/* Loads one file as 16 bit samples in host order */
+static int _bankLoad(AL_bank_sound *sound, char *file)
+{
+	const char *base = strrchr(file, '/') ? strrchr(file, '/') + 1 : file;
+	size_t len = strlen(base);
+	ALenum format;
+	ALvoid *data;
+	ALsizei size, freq, i;
+	ALboolean loop;
+
+	if (len > 4 && !strcmp(base + len - 4, ".wav"))
+	{
+		len -= 4;
+	}
+
+	if (len >= _ALUT_BANK_NAME)
+	{
+		fprintf(stderr, "%s: name too long\n", file);
+		return 0;
+	}
+
+	memset(sound->entry.name, 0, _ALUT_BANK_NAME);
+	memcpy(sound->entry.name, base, len);
+
+	data = 0;
+	alutLoadWAVFile((ALbyte *)file, &format, &data, &size, &freq, &loop);
+
+	if (!data)
+	{
+		fprintf(stderr, "%s: not a wav file\n", file);
+		return 0;
+	}
+
+	switch (format)
+	{
+	case AL_FORMAT_MONO8:
+	case AL_FORMAT_STEREO8:
+		{
+			u_int8_t *from = data;
+			int16_t *to;
+
+			if (!(to = malloc(size << 1)))
+			{
+				return 0;
+			}
+
+			for (i = 0; i < size; i++)
+			{
+				to[i] = (from[i] - 128) << 8;
+			}
+
+			alutUnloadWAV(format, data, size, freq);
+
+			data = to;
+			size <<= 1;
+			format = format == AL_FORMAT_MONO8 ?
+				 AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+		}
+		break;
+	case AL_FORMAT_MONO16:
+		size &= ~1;
+		break;
+	case AL_FORMAT_STEREO16:
+		size &= ~3;
+		break;
+	}
+
+	sound->entry.format = format;
+	sound->entry.freq = freq;
+	sound->entry.size = size;
+	sound->data = data;
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	static const char pad[_ALUT_BANK_ALIGN];
+	AL_bank_header header;
+	AL_bank_sound *sounds;
+	u_int32_t offset;
+	FILE *out;
+	int count = argc - 2;
+	int i;
+
+	if (count < 1)
+	{
+		fprintf(stderr, "usage: %s bank file.wav...\n", argv[0]);
+		return 1;
+	}
+
+	if (!(sounds = calloc(count, sizeof(AL_bank_sound))))
+	{
+		return 1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!_bankLoad(&sounds[i], argv[i + 2]))
+		{
+			return 1;
+		}
+	}
+
+	/* The library looks sounds up with bsearch */
+	qsort(sounds, count, sizeof(AL_bank_sound), _bankCompare);
+
+	for (i = 1; i < count; i++)
+	{
+		if (!_bankCompare(&sounds[i - 1], &sounds[i]))
+		{
+			fprintf(stderr, "%s: given twice\n", sounds[i].entry.name);
+			return 1;
+		}
+	}
+
+	offset = sizeof(AL_bank_header) + count * sizeof(AL_bank_entry);
+
+	for (i = 0; i < count; i++)
+	{
+		offset = (offset + _ALUT_BANK_ALIGN - 1) &
+			 ~(_ALUT_BANK_ALIGN - 1);
+		sounds[i].entry.offset = offset;
+		offset += sounds[i].entry.size;
+	}
+
+	if (!(out = fopen(argv[1], "wb")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	header.magic = swap32le(_ALUT_BANK_MAGIC);
+	header.version = swap32le(_ALUT_BANK_VERSION);
+	header.count = swap32le(count);
+	header.reserved = 0;
+
+	fwrite(&header, sizeof(header), 1, out);
+
+	for (i = 0; i < count; i++)
+	{
+		AL_bank_entry entry = sounds[i].entry;
+
+		entry.format = swap32le(entry.format);
+		entry.freq = swap32le(entry.freq);
+		entry.offset = swap32le(entry.offset);
+		entry.size = swap32le(entry.size);
+
+		fwrite(&entry, sizeof(entry), 1, out);
+	}
+
+	offset = sizeof(AL_bank_header) + count * sizeof(AL_bank_entry);
+
+	for (i = 0; i < count; i++)
+	{
+		u_int16_t *data = sounds[i].data;
+		u_int32_t j;
+
+		fwrite(pad, sounds[i].entry.offset - offset, 1, out);
+
+		for (j = 0; j < (sounds[i].entry.size >> 1); j++)
+		{
+			data[j] = swap16le(data[j]);
+		}
+
+		fwrite(data, sounds[i].entry.size, 1, out);
+		offset = sounds[i].entry.offset + sounds[i].entry.size;
+
+		free(data);
+	}
+
+	if (fclose(out))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <AL/al.h>
+#include <AL/alext.h>
+
+#include "alut_bank.h"
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define swap16le(D) (D)
+#define swap32le(D) (D)
+#elif __BYTE_ORDER == __BIG_ENDIAN
+#define swap16le(D) ((u_int16_t)(((D)<<8) | ((D)>>8)))
+#define swap32le(D) ((((D)<<24) | (((D)<<8)&0x00FF0000) | (((D)>>8)&0x0000FF00) | ((D)>>24)))
+#else
+#error "Unknown endian"
+#endif
+
+struct _alBank_EXT
+{
+	void *memory;
+	size_t length;
+	ALuint count;
+	AL_bank_entry *index;
+	ALuint buffers[];
+};
+
+static ALboolean _alutCheckEntry(AL_bank_entry *entry, size_t length)
+{
+	u_int32_t offset = swap32le(entry->offset);
+	u_int32_t size = swap32le(entry->size);
+
+	if (memchr(entry->name, 0, _ALUT_BANK_NAME) == 0)
+	{
+		return AL_FALSE;
+	}
+
+	/* What alBufferDataStatic_EXT takes */
+	if (size > INT_MAX || swap32le(entry->freq) == 0)
+	{
+		return AL_FALSE;
+	}
+
+	switch (swap32le(entry->format))
+	{
+	case AL_FORMAT_MONO16:
+		if (size & 1)
+		{
+			return AL_FALSE;
+		}
+		break;
+	case AL_FORMAT_STEREO16:
+		if (size & 3)
+		{
+			return AL_FALSE;
+		}
+		break;
+	default:
+		return AL_FALSE;
+	}
+
+	return !(offset & (_ALUT_BANK_ALIGN - 1)) &&
+		offset <= length && size <= length - offset;
+}
+
+static ALvoid _alutBankData(ALuint bid, AL_bank_entry *entry,
+			    ALbyte *memory)
+{
+	ALenum format = swap32le(entry->format);
+	ALsizei size = swap32le(entry->size);
+	ALsizei freq = swap32le(entry->freq);
+	ALvoid *data = memory + swap32le(entry->offset);
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	/* Already what the mixer reads, pages come in as they are played */
+	alBufferDataStatic_EXT(bid, format, data, size, freq);
+#else
+	{
+		u_int16_t *from = data;
+		u_int16_t *copy;
+		ALsizei i;
+
+		if (!(copy = malloc(size)))
+		{
+			return;
+		}
+
+		for (i = 0; i < (size >> 1); i++)
+		{
+			copy[i] = swap16le(from[i]);
+		}
+
+		alBufferData(bid, format, copy, size, freq);
+		free(copy);
+	}
+#endif
+}
+
+alBank_EXT *alutOpenBank_EXT(const ALubyte *file)
+{
+	alBank_EXT *bank;
+	AL_bank_header *header;
+	void *memory;
+	struct stat st;
+	ALuint count, i;
+	int fd;
+
+	if ((fd = open((const char *)file, O_RDONLY)) < 0)
+	{
+		return 0;
+	}
+
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(AL_bank_header))
+	{
+		close(fd);
+		return 0;
+	}
+
+	memory = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+	{
+		return 0;
+	}
+
+	header = memory;
+	count = swap32le(header->count);
+
+	if (swap32le(header->magic) != _ALUT_BANK_MAGIC ||
+	    swap32le(header->version) != _ALUT_BANK_VERSION ||
+	    count > (st.st_size - sizeof(AL_bank_header)) /
+		    sizeof(AL_bank_entry))
+	{
+		goto unmap;
+	}
+
+	if (!(bank = malloc(sizeof(alBank_EXT) + count * sizeof(ALuint))))
+	{
+		goto unmap;
+	}
+
+	bank->memory = memory;
+	bank->length = st.st_size;
+	bank->count = count;
+	bank->index = (AL_bank_entry *)(header + 1);
+
+	for (i = 0; i < count; i++)
+	{
+		if (!_alutCheckEntry(&bank->index[i], bank->length))
+		{
+			goto release;
+		}
+	}
+
+	if (count)
+	{
+		bank->buffers[0] = 0;
+		alGenBuffers(count, bank->buffers);
+
+		if (!bank->buffers[0])
+		{
+			goto release;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		_alutBankData(bank->buffers[i], &bank->index[i], memory);
+	}
+
+	return bank;
+
+release:
+	free(bank);
+unmap:
+	munmap(memory, st.st_size);
+	return 0;
+}
+
+static int _alutCompareEntry(const void *name, const void *entry)
+{
+	return strcmp(name, ((const AL_bank_entry *)entry)->name);
+}
+
+ALuint alutGetBankBuffer_EXT(alBank_EXT *bank, const ALubyte *name)
+{
+	AL_bank_entry *entry;
+
+	entry = bsearch(name, bank->index, bank->count,
+			sizeof(AL_bank_entry), _alutCompareEntry);
+
+	return entry ? bank->buffers[entry - bank->index] : 0;
+}
+
+ALboolean alutCloseBank_EXT(alBank_EXT *bank)
+{
+	if (bank->count)
+	{
+		/* All or nothing, fails while any of them is still used */
+		alDeleteBuffers(bank->count, bank->buffers);
+
+		if (alIsBuffer(bank->buffers[0]))
+		{
+			return AL_FALSE;
+		}
+	}
+
+	munmap(bank->memory, bank->length);
+	free(bank);
+
+	return AL_TRUE;
+}
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2004 Christopher John Purnell
+ *                     cjp@lost.org.uk
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _ALUT_BANK_H_
+#define _ALUT_BANK_H_
+
+#include <sys/types.h>
+
+/* A sample bank is one file holding many sounds ready to play.  All
+   fields are little endian.  The header is followed by count index
+   entries sorted by name, then the samples as signed 16 bit mono or
+   interleaved stereo, each starting on a _ALUT_BANK_ALIGN boundary. */
+
+#define _ALUT_BANK_MAGIC 0x4B424C41	/* "ALBK" */
+#define _ALUT_BANK_VERSION 1
+#define _ALUT_BANK_ALIGN 16
+#define _ALUT_BANK_NAME 32
+
+typedef struct _AL_bank_header
+{
+	u_int32_t magic;
+	u_int32_t version;
+	u_int32_t count;
+	u_int32_t reserved;
+}
+AL_bank_header;
+
+typedef struct _AL_bank_entry
+{
+	char name[_ALUT_BANK_NAME];	/* nul terminated */
+	u_int32_t format;		/* AL_FORMAT_MONO16 or STEREO16 */
+	u_int32_t freq;
+	u_int32_t offset;		/* from the start of the file */
+	u_int32_t size;			/* in bytes */
+}
+AL_bank_entry;
+
+#endif